@@ -0,0 +1,100 @@
+#include "concurrent_search_server.h"
+
+#include <utility>
+
+std::shared_ptr<const SearchServer> ConcurrentSearchServer::GetSnapshot() const {
+    return std::atomic_load(&published_);
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+                                         const std::vector<int>& ratings) {
+    Write([document_id, document = std::string(document), status, ratings](SearchServer& search_server) {
+        search_server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(const std::vector<SearchServer::NewDocument>& documents) {
+    // The batch is replayed later, so it gets its own copy of the texts
+    auto texts = std::make_shared<std::vector<std::string>>();
+    texts->reserve(documents.size());
+    auto batch = documents;
+    for (SearchServer::NewDocument& document : batch) {
+        document.text = texts->emplace_back(document.text);
+    }
+    Write([texts, batch = std::move(batch)](SearchServer& search_server) {
+        search_server.AddDocuments(std::execution::par, batch);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Write([document_id](SearchServer& search_server) {
+        search_server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    Write([document_ids](SearchServer& search_server) {
+        search_server.RemoveDocuments(document_ids);
+    });
+}
+
+void ConcurrentSearchServer::SetDocumentStatus(int document_id, DocumentStatus status) {
+    Write([document_id, status](SearchServer& search_server) {
+        search_server.SetDocumentStatus(document_id, status);
+    });
+}
+
+void ConcurrentSearchServer::CompactIndex() {
+    Write([](SearchServer& search_server) {
+        search_server.CompactIndex();
+    });
+}
+
+void ConcurrentSearchServer::EnableResultCache(size_t memory_budget) {
+    // Each copy gets its own cache, so the budget is split between them
+    Write([memory_budget](SearchServer& search_server) {
+        search_server.EnableResultCache(memory_budget / 2);
+    });
+}
+
+void ConcurrentSearchServer::Write(Change change) {
+    std::lock_guard lock(write_mutex_);
+    // The standby copy was published before the previous write, nobody can take it anew
+    bool is_released;
+    {
+        std::lock_guard release_lock(standby_release_->mutex);
+        is_released = standby_release_->is_released;
+    }
+    if (is_released) {
+        for (const Change& pending_change : pending_changes_) {
+            pending_change(*standby_);
+        }
+    } else {
+        // Readers keep the old copy alive as long as they hold it
+        standby_ = std::make_shared<SearchServer>(*published_copy_);
+        standby_release_ = std::make_shared<ReleaseState>();
+    }
+    pending_changes_.clear();
+
+    // A rejected change (e.g. a duplicate id) leaves both copies as they were
+    change(*standby_);
+    pending_changes_.push_back(std::move(change));
+
+    // Readers move to the changed copy, the copy published so far becomes the standby one
+    // and the handle dropped here is released by its last reader
+    auto release_state = std::make_shared<ReleaseState>();
+    release_state->is_released = false;
+    std::atomic_store(&published_, MakeHandle(standby_, release_state));
+    std::swap(published_copy_, standby_);
+    standby_release_ = std::move(published_release_);
+    published_release_ = std::move(release_state);
+}
+
+std::shared_ptr<const SearchServer> ConcurrentSearchServer::MakeHandle(std::shared_ptr<SearchServer> search_server,
+                                                                       std::shared_ptr<ReleaseState> release_state) {
+    SearchServer* const copy = search_server.get();
+    return std::shared_ptr<const SearchServer>(copy, [search_server = std::move(search_server), release_state = std::move(release_state)](const SearchServer*) {
+        std::lock_guard release_lock(release_state->mutex);
+        release_state->is_released = true;
+    });
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "search_server.h"
+
+// SearchServer that serves readers while it is being written to. Two copies of the index are
+// kept: readers take the published copy with GetSnapshot, a writer changes the other one and
+// publishes it, so reads never wait for writes and writes never wait for reads. The change is
+// replayed on the previously published copy by the next write. If a reader still holds that
+// copy, it is left to the reader and the write starts from a new copy of the published one.
+// Results obtained from a snapshot (e.g. matched words) stay valid while the snapshot is held.
+class ConcurrentSearchServer {
+public:
+    template <typename... SearchServerArgs>
+    explicit ConcurrentSearchServer(const SearchServerArgs&... args);
+
+    std::shared_ptr<const SearchServer> GetSnapshot() const;
+
+    template <typename... FindArgs>
+    std::vector<Document> FindTopDocuments(const FindArgs&... args) const;
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+    void AddDocuments(const std::vector<SearchServer::NewDocument>& documents);
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void SetDocumentStatus(int document_id, DocumentStatus status);
+    void CompactIndex();
+    // Results cached by the published copy are reported by GetSnapshot()->GetResultCacheStats()
+    void EnableResultCache(size_t memory_budget);
+
+private:
+    using Change = std::function<void(SearchServer&)>;
+    // Set when the last reader drops the handle of a published copy
+    struct ReleaseState {
+        std::mutex mutex;
+        bool is_released = true;
+    };
+
+    std::shared_ptr<const SearchServer> published_;  // reader handle of published_copy_
+    std::shared_ptr<SearchServer> published_copy_;
+    std::shared_ptr<ReleaseState> published_release_;
+    std::shared_ptr<SearchServer> standby_;
+    // Release of the handle the standby copy was last published with
+    std::shared_ptr<ReleaseState> standby_release_;
+    // Changes already applied to the published copy and still missing from the standby one
+    std::vector<Change> pending_changes_;
+    std::mutex write_mutex_;
+
+    void Write(Change change);
+    // Reader handle of a copy: it keeps the copy alive and reports when the last reader is done
+    static std::shared_ptr<const SearchServer> MakeHandle(std::shared_ptr<SearchServer> search_server,
+                                                          std::shared_ptr<ReleaseState> release_state);
+};
+
+template <typename... SearchServerArgs>
+ConcurrentSearchServer::ConcurrentSearchServer(const SearchServerArgs&... args)
+        : published_copy_(std::make_shared<SearchServer>(args...))
+        , published_release_(std::make_shared<ReleaseState>())
+        , standby_(std::make_shared<SearchServer>(args...))
+        , standby_release_(std::make_shared<ReleaseState>())
+{
+    published_release_->is_released = false;
+    published_ = MakeHandle(published_copy_, published_release_);
+}
+
+template <typename... FindArgs>
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(const FindArgs&... args) const {
+    return GetSnapshot()->FindTopDocuments(args...);
+}
@@ -1,6 +1,16 @@
 #include "document.h"
 
+#include <cmath>
+
 std::ostream& operator<< (std::ostream& out, const Document& doc) {
     out << "{ document_id = " << doc.id << ", relevance = " << doc.relevance << ", rating = " << doc.rating << " }";
     return out;
+}
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < DELTA) {
+        return lhs.rating > rhs.rating;
+    } else {
+        return lhs.relevance > rhs.relevance;
+    }
 }
\ No newline at end of file
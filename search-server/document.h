@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <set>
 #include <string>
 #include <iostream>
@@ -7,7 +8,7 @@
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double DELTA = 1e-06;
 
-enum class DocumentStatus {
+enum class DocumentStatus : std::uint8_t {
     ACTUAL,
     IRRELEVANT,
     BANNED,
@@ -28,4 +29,7 @@ struct Document {
     int rating = 0;
 };
 
-std::ostream& operator<< (std::ostream& out, const Document& doc);
\ No newline at end of file
+std::ostream& operator<< (std::ostream& out, const Document& doc);
+
+// Result order of FindTopDocuments: relevance first, rating breaks near-equal relevance
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "document.h"
+
+// Filters of FindTopDocuments the search server recognizes at compile time. Instead of calling
+// them per document it reads the status and rating columns indexed by document ordinal.
+// They can also be called like any document predicate.
+
+struct AcceptAll {
+    bool operator()(int, DocumentStatus, int) const {
+        return true;
+    }
+};
+
+struct StatusIs {
+    DocumentStatus status;
+
+    bool operator()(int, DocumentStatus document_status, int) const {
+        return document_status == status;
+    }
+};
+
+// Both bounds are included
+struct RatingBetween {
+    int min_rating;
+    int max_rating;
+
+    bool operator()(int, DocumentStatus, int rating) const {
+        return rating >= min_rating && rating <= max_rating;
+    }
+};
@@ -0,0 +1,102 @@
+#include "index_segment.h"
+
+#include <algorithm>
+#include <utility>
+
+IndexSegment::IndexSegment(int first_ordinal, int last_ordinal, size_t document_count,
+                           std::vector<TermId> terms, std::vector<PostingList> postings,
+                           std::shared_ptr<const SnapshotReader> snapshot)
+        : first_ordinal_(first_ordinal)
+        , last_ordinal_(last_ordinal)
+        , document_count_(document_count)
+        , terms_(std::move(terms))
+        , postings_(std::move(postings))
+        , snapshot_(std::move(snapshot))
+{
+}
+
+int IndexSegment::GetFirstOrdinal() const {
+    return first_ordinal_;
+}
+
+int IndexSegment::GetLastOrdinal() const {
+    return last_ordinal_;
+}
+
+size_t IndexSegment::GetDocumentCount() const {
+    return document_count_;
+}
+
+const PostingList* IndexSegment::FindPostings(TermId term) const {
+    const auto it = std::lower_bound(terms_.begin(), terms_.end(), term);
+    if (it == terms_.end() || *it != term) {
+        return nullptr;
+    }
+    return &postings_[it - terms_.begin()];
+}
+
+IndexSegment IndexSegment::Merge(const std::vector<std::shared_ptr<const IndexSegment>>& segments,
+                                 const std::vector<bool>& is_removed, PostingStorage storage) {
+    const int first_ordinal = segments.front()->first_ordinal_;
+    std::vector<TermId> terms;
+    std::vector<PostingList> postings;
+    std::vector<int> document_ids;
+    std::vector<double> term_freqs;
+    // Position in the term list of every merged segment
+    std::vector<size_t> term_indexes(segments.size(), 0);
+    while (true) {
+        TermId term = TermDictionary::NO_TERM;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (term_indexes[i] < segments[i]->terms_.size()) {
+                term = std::min(term, segments[i]->terms_[term_indexes[i]]);
+            }
+        }
+        if (term == TermDictionary::NO_TERM) {
+            break;
+        }
+        document_ids.clear();
+        term_freqs.clear();
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (term_indexes[i] == segments[i]->terms_.size() || segments[i]->terms_[term_indexes[i]] != term) {
+                continue;
+            }
+            segments[i]->postings_[term_indexes[i]++].ForEach([&](int ordinal, double term_freq) {
+                if (!is_removed[ordinal - first_ordinal]) {
+                    document_ids.push_back(ordinal);
+                    term_freqs.push_back(term_freq);
+                }
+            });
+        }
+        if (!document_ids.empty()) {
+            terms.push_back(term);
+            postings.emplace_back(storage).Append(document_ids.data(), term_freqs.data(), document_ids.size());
+        }
+    }
+
+    const size_t document_count = std::count(is_removed.begin(), is_removed.end(), false);
+    return IndexSegment(first_ordinal, segments.back()->last_ordinal_, document_count, std::move(terms), std::move(postings));
+}
+
+IndexSegment IndexSegment::Renumber(const std::vector<int>& new_ordinals, PostingStorage storage) const {
+    std::vector<TermId> terms;
+    std::vector<PostingList> postings;
+    std::vector<int> document_ids;
+    std::vector<double> term_freqs;
+    for (size_t i = 0; i < terms_.size(); ++i) {
+        document_ids.clear();
+        term_freqs.clear();
+        postings_[i].ForEach([&](int ordinal, double term_freq) {
+            if (new_ordinals[ordinal + 1] != new_ordinals[ordinal]) {
+                document_ids.push_back(new_ordinals[ordinal]);
+                term_freqs.push_back(term_freq);
+            }
+        });
+        if (!document_ids.empty()) {
+            terms.push_back(terms_[i]);
+            postings.emplace_back(storage).Append(document_ids.data(), term_freqs.data(), document_ids.size());
+        }
+    }
+    const int first_ordinal = new_ordinals[first_ordinal_];
+    const int last_ordinal = new_ordinals[last_ordinal_];
+    return IndexSegment(first_ordinal, last_ordinal, static_cast<size_t>(last_ordinal - first_ordinal), std::move(terms), std::move(postings));
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "posting_list.h"
+#include "term_dictionary.h"
+
+class SnapshotReader;
+
+// Posting lists of the documents with ordinals in [first_ordinal, last_ordinal). A segment is
+// never changed once built: removed documents are tracked outside of it and their postings
+// are dropped when the segment is merged with a neighbour.
+// A segment loaded from a snapshot holds views into the mapped file and keeps it mapped.
+class IndexSegment {
+public:
+    // terms must be sorted, postings[i] holds the postings of terms[i]. The snapshot is the one
+    // the postings view, if they do
+    IndexSegment(int first_ordinal, int last_ordinal, size_t document_count,
+                 std::vector<TermId> terms, std::vector<PostingList> postings,
+                 std::shared_ptr<const SnapshotReader> snapshot = nullptr);
+
+    int GetFirstOrdinal() const;
+    int GetLastOrdinal() const;
+    size_t GetDocumentCount() const;
+
+    // nullptr when no document of the segment has the term
+    const PostingList* FindPostings(TermId term) const;
+
+    // Joins adjacent segments given in ordinal order into one, leaving out the removed postings.
+    // is_removed[i] tells whether ordinal segments.front()->GetFirstOrdinal() + i is removed.
+    // A single segment is simply compacted.
+    static IndexSegment Merge(const std::vector<std::shared_ptr<const IndexSegment>>& segments,
+                              const std::vector<bool>& is_removed, PostingStorage storage);
+    // Copy of the segment with dense ordinals, leaving out the removed postings. new_ordinals[o] is
+    // the number of live ordinals before o, so o is removed when new_ordinals[o + 1] == new_ordinals[o].
+    IndexSegment Renumber(const std::vector<int>& new_ordinals, PostingStorage storage) const;
+
+private:
+    int first_ordinal_;
+    int last_ordinal_;
+    size_t document_count_;
+    std::vector<TermId> terms_;
+    std::vector<PostingList> postings_;
+    std::shared_ptr<const SnapshotReader> snapshot_;
+};
@@ -1,5 +1,6 @@
 #include "search_server.h"
 #include "log_duration.h"
+#include "tests.h"
 #include <execution>
 #include <iostream>
 #include <random>
@@ -58,6 +59,7 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
 }
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 int main() {
+    TestSearchServer();
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
@@ -0,0 +1,312 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Block layout follows SIMD-BP128: value i of a block lives in lane i % 4 at row i / 4,
+// and every lane is a separate bit stream, so one 128-bit load unpacks four values.
+constexpr size_t LANE_COUNT = 4;
+constexpr size_t ROW_COUNT = PostingList::BLOCK_SIZE / LANE_COUNT;
+
+// Term frequencies are stored as a 12-bit mantissa with a 4-bit scale:
+// value = mantissa / 2^(11 + scale).
+constexpr int MANTISSA_BITS = 12;
+constexpr int MAX_MANTISSA = (1 << MANTISSA_BITS) - 1;
+constexpr int MAX_SCALE = 15;
+
+struct TermFreqScales {
+    double values[MAX_SCALE + 1];
+
+    constexpr TermFreqScales() : values() {
+        for (int scale = 0; scale <= MAX_SCALE; ++scale) {
+            values[scale] = 1.0 / static_cast<double>(1 << (MANTISSA_BITS - 1 + scale));
+        }
+    }
+};
+
+constexpr TermFreqScales TERM_FREQ_SCALES;
+
+std::uint8_t GetBitWidth(std::uint32_t value) {
+    std::uint8_t width = 0;
+    while (value != 0) {
+        ++width;
+        value >>= 1;
+    }
+    return width;
+}
+
+}  // namespace
+
+PostingList::PostingList(PostingStorage storage)
+        : storage_(storage) {
+}
+
+PostingList PostingList::MakeView(const int* document_ids, const double* term_freqs, size_t count, double max_term_freq) {
+    PostingList postings;
+    postings.is_view_ = true;
+    postings.view_document_ids_ = document_ids;
+    postings.view_term_freqs_ = term_freqs;
+    postings.view_size_ = count;
+    postings.max_term_freq_ = max_term_freq;
+    return postings;
+}
+
+void PostingList::Add(int document_id, double term_freq) {
+    // Compressed postings are scored with the quantized value, which may round up
+    max_term_freq_ = std::max(max_term_freq_, storage_ == PostingStorage::COMPRESSED
+                                              ? std::max(term_freq, DequantizeTermFreq(QuantizeTermFreq(term_freq)))
+                                              : term_freq);
+    document_ids_.push_back(document_id);
+    term_freqs_.push_back(term_freq);
+    if (storage_ == PostingStorage::COMPRESSED && document_ids_.size() == BLOCK_SIZE) {
+        FlushTail();
+    }
+}
+
+void PostingList::Append(const int* document_ids, const double* term_freqs, size_t count) {
+    if (storage_ == PostingStorage::COMPRESSED) {
+        for (size_t i = 0; i < count; ++i) {
+            Add(document_ids[i], term_freqs[i]);
+        }
+        return;
+    }
+    document_ids_.insert(document_ids_.end(), document_ids, document_ids + count);
+    term_freqs_.insert(term_freqs_.end(), term_freqs, term_freqs + count);
+    for (size_t i = 0; i < count; ++i) {
+        max_term_freq_ = std::max(max_term_freq_, term_freqs[i]);
+    }
+}
+
+bool PostingList::Contains(int document_id) const {
+    if (!blocks_.empty() && document_id <= blocks_.back().last_document_id) {
+        const Block& block = blocks_[FindBlock(document_id)];
+        int block_document_ids[BLOCK_SIZE];
+        DecodeBlock(block, block_document_ids);
+        const auto it = std::lower_bound(block_document_ids, block_document_ids + block.count, document_id);
+        const size_t position = std::distance(block_document_ids, it);
+        return position < block.count && *it == document_id;
+    }
+    const size_t position = FindPosition(document_id);
+    return position < GetPlainSize() && GetPlainDocumentIds()[position] == document_id;
+}
+
+size_t PostingList::GetSize() const {
+    return block_postings_count_ + GetPlainSize();
+}
+
+bool PostingList::IsEmpty() const {
+    return GetSize() == 0;
+}
+
+double PostingList::GetMaxTermFreq() const {
+    return max_term_freq_;
+}
+
+size_t PostingList::FindPosition(int document_id) const {
+    const int* const document_ids = GetPlainDocumentIds();
+    return std::distance(document_ids, std::lower_bound(document_ids, document_ids + GetPlainSize(), document_id));
+}
+
+size_t PostingList::FindBlock(int document_id) const {
+    return std::distance(blocks_.begin(), std::lower_bound(blocks_.begin(), blocks_.end(), document_id,
+                                                           [](const Block& block, int id) {
+                                                               return block.last_document_id < id;
+                                                           }));
+}
+
+void PostingList::FlushTail() {
+    std::vector<std::uint16_t> quantized_term_freqs(term_freqs_.size());
+    std::transform(term_freqs_.begin(), term_freqs_.end(), quantized_term_freqs.begin(), QuantizeTermFreq);
+    blocks_.push_back(EncodeBlock(document_ids_.data(), quantized_term_freqs.data(), document_ids_.size()));
+    block_postings_count_ += document_ids_.size();
+    document_ids_.clear();
+    term_freqs_.clear();
+}
+
+PostingList::Block PostingList::EncodeBlock(const int* document_ids, const std::uint16_t* term_freqs, size_t count) {
+    Block block;
+    block.first_document_id = document_ids[0];
+    block.last_document_id = document_ids[count - 1];
+    block.count = static_cast<std::uint16_t>(count);
+    block.term_freqs.assign(term_freqs, term_freqs + count);
+
+    // Ids are strictly increasing, so each gap is stored minus one; padding slots stay zero
+    std::uint32_t deltas[BLOCK_SIZE] = {};
+    std::uint32_t max_delta = 0;
+    for (size_t i = 1; i < count; ++i) {
+        deltas[i] = static_cast<std::uint32_t>(document_ids[i] - document_ids[i - 1] - 1);
+        max_delta = std::max(max_delta, deltas[i]);
+    }
+    block.bit_width = GetBitWidth(max_delta);
+    block.packed_deltas.assign(LANE_COUNT * block.bit_width, 0);
+    for (size_t i = 0; i < BLOCK_SIZE && block.bit_width != 0; ++i) {
+        const size_t lane = i % LANE_COUNT;
+        const size_t bit_offset = (i / LANE_COUNT) * block.bit_width;
+        const size_t word = bit_offset / 32;
+        const size_t shift = bit_offset % 32;
+        block.packed_deltas[word * LANE_COUNT + lane] |= deltas[i] << shift;
+        if (shift + block.bit_width > 32) {
+            block.packed_deltas[(word + 1) * LANE_COUNT + lane] |= deltas[i] >> (32 - shift);
+        }
+    }
+    return block;
+}
+
+void PostingList::DecodeBlock(const Block& block, int* document_ids) {
+#if defined(__SSE2__)
+    DecodeBlockSse2(block, document_ids);
+#else
+    DecodeBlockScalar(block, document_ids);
+#endif
+}
+
+void PostingList::DecodeBlockScalar(const Block& block, int* document_ids) {
+    const std::uint32_t bit_width = block.bit_width;
+    const std::uint32_t* packed = block.packed_deltas.data();
+    const std::uint32_t mask = static_cast<std::uint32_t>((std::uint64_t{1} << bit_width) - 1);
+    // Padding slots may run past INT_MAX, so the running sum is kept unsigned
+    auto previous = static_cast<std::uint32_t>(block.first_document_id) - 1;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        std::uint32_t delta = 0;
+        if (bit_width != 0) {
+            const size_t lane = i % LANE_COUNT;
+            const size_t bit_offset = (i / LANE_COUNT) * bit_width;
+            const size_t word = bit_offset / 32;
+            const size_t shift = bit_offset % 32;
+            delta = packed[word * LANE_COUNT + lane] >> shift;
+            if (shift + bit_width > 32) {
+                delta |= packed[(word + 1) * LANE_COUNT + lane] << (32 - shift);
+            }
+            delta &= mask;
+        }
+        previous += delta + 1;
+        document_ids[i] = static_cast<int>(previous);
+    }
+}
+
+#if defined(__SSE2__)
+void PostingList::DecodeBlockSse2(const Block& block, int* document_ids) {
+    const std::uint32_t bit_width = block.bit_width;
+    const std::uint32_t* packed = block.packed_deltas.data();
+    const __m128i mask = _mm_set1_epi32(static_cast<int>((std::uint64_t{1} << bit_width) - 1));
+    const __m128i ones = _mm_set1_epi32(1);
+    __m128i previous = _mm_set1_epi32(block.first_document_id - 1);
+    for (size_t row = 0; row < ROW_COUNT; ++row) {
+        __m128i deltas = _mm_setzero_si128();
+        if (bit_width != 0) {
+            const size_t bit_offset = row * bit_width;
+            const size_t word = bit_offset / 32;
+            const std::uint32_t shift = bit_offset % 32;
+            deltas = _mm_srl_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + word * LANE_COUNT)),
+                                   _mm_cvtsi32_si128(static_cast<int>(shift)));
+            if (shift + bit_width > 32) {
+                const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + (word + 1) * LANE_COUNT));
+                deltas = _mm_or_si128(deltas, _mm_sll_epi32(high, _mm_cvtsi32_si128(static_cast<int>(32 - shift))));
+            }
+            deltas = _mm_and_si128(deltas, mask);
+        }
+        // Prefix sum of (delta + 1) over the four lanes, continued from the previous row
+        __m128i ids = _mm_add_epi32(deltas, ones);
+        ids = _mm_add_epi32(ids, _mm_slli_si128(ids, 4));
+        ids = _mm_add_epi32(ids, _mm_slli_si128(ids, 8));
+        ids = _mm_add_epi32(ids, previous);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(document_ids + row * LANE_COUNT), ids);
+        previous = _mm_shuffle_epi32(ids, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+}
+#endif
+
+std::uint16_t PostingList::QuantizeTermFreq(double term_freq) {
+    if (term_freq == 0.0) {
+        return 0;
+    }
+    int scale = 0;
+    while (scale < MAX_SCALE && std::ldexp(term_freq, MANTISSA_BITS + scale) < MAX_MANTISSA + 0.5) {
+        ++scale;
+    }
+    const long mantissa = std::lround(std::ldexp(term_freq, MANTISSA_BITS - 1 + scale));
+    return static_cast<std::uint16_t>((scale << MANTISSA_BITS) | std::clamp<long>(mantissa, 1, MAX_MANTISSA));
+}
+
+double PostingList::DequantizeTermFreq(std::uint16_t term_freq) {
+    return (term_freq & MAX_MANTISSA) * TERM_FREQ_SCALES.values[term_freq >> MANTISSA_BITS];
+}
+
+void PostingList::DecodeBlock(const Block& block, int* document_ids, double* term_freqs) {
+    DecodeBlock(block, document_ids);
+    for (size_t i = 0; i < block.count; ++i) {
+        term_freqs[i] = DequantizeTermFreq(block.term_freqs[i]);
+    }
+}
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+        : postings_(&postings) {
+    if (!postings_->blocks_.empty()) {
+        LoadBlock();
+    }
+    Settle();
+}
+
+void PostingList::Cursor::Next() {
+    ++position_;
+    Settle();
+}
+
+void PostingList::Cursor::SkipTo(int document_id) {
+    if (at_end_ || document_id_ >= document_id) {
+        return;
+    }
+    const auto& blocks = postings_->blocks_;
+    if (block_index_ < blocks.size() && blocks[block_index_].last_document_id < document_id) {
+        block_index_ = std::distance(blocks.begin(), std::lower_bound(blocks.begin() + block_index_ + 1, blocks.end(), document_id,
+                                                                      [](const Block& block, int id) {
+                                                                          return block.last_document_id < id;
+                                                                      }));
+        position_ = 0;
+        if (block_index_ < blocks.size()) {
+            LoadBlock();
+        }
+    }
+    if (block_index_ < blocks.size()) {
+        int* const ids_end = block_document_ids_ + blocks[block_index_].count;
+        position_ = std::distance(block_document_ids_, std::lower_bound(block_document_ids_ + position_, ids_end, document_id));
+    } else {
+        const int* const tail_ids = postings_->GetPlainDocumentIds();
+        position_ = std::distance(tail_ids, std::lower_bound(tail_ids + position_, tail_ids + postings_->GetPlainSize(), document_id));
+    }
+    Settle();
+}
+
+void PostingList::Cursor::LoadBlock() {
+    DecodeBlock(postings_->blocks_[block_index_], block_document_ids_, block_term_freqs_);
+}
+
+void PostingList::Cursor::Settle() {
+    const auto& blocks = postings_->blocks_;
+    while (block_index_ < blocks.size()) {
+        if (position_ < blocks[block_index_].count) {
+            document_id_ = block_document_ids_[position_];
+            term_freq_ = block_term_freqs_[position_];
+            return;
+        }
+        ++block_index_;
+        position_ = 0;
+        if (block_index_ < blocks.size()) {
+            LoadBlock();
+        }
+    }
+    if (position_ < postings_->GetPlainSize()) {
+        document_id_ = postings_->GetPlainDocumentIds()[position_];
+        term_freq_ = postings_->GetPlainTermFreqs()[position_];
+        return;
+    }
+    at_end_ = true;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class PostingStorage {
+    PLAIN,
+    COMPRESSED,
+};
+
+// Postings of a single term: document ids and term frequencies kept in two parallel
+// arrays sorted by document id. Lists only grow at the end; removed documents are
+// tracked by the tombstone bitmap of the index and dropped when a list is rebuilt.
+//
+// In COMPRESSED storage full runs of BLOCK_SIZE postings are packed into blocks:
+// document ids are delta-encoded and bit-packed, term frequencies are quantized
+// to 16 bits. The most recent postings stay in the plain arrays until a block fills up.
+//
+// A view reads plain postings from arrays it does not own, e.g. in a mapped snapshot.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    class Cursor;
+
+    explicit PostingList(PostingStorage storage = PostingStorage::PLAIN);
+    // The arrays must be sorted by id and outlive the view, which must not be added to
+    static PostingList MakeView(const int* document_ids, const double* term_freqs, size_t count, double max_term_freq);
+
+    // The id must be past the last id of the list
+    void Add(int document_id, double term_freq);
+    // Bulk Add of postings sorted by id, all past the last id of the list
+    void Append(const int* document_ids, const double* term_freqs, size_t count);
+    bool Contains(int document_id) const;
+
+    size_t GetSize() const;
+    bool IsEmpty() const;
+    // Upper bound of the term frequencies in the list, used to prune query evaluation
+    double GetMaxTermFreq() const;
+
+    template <typename Function>
+    void ForEach(Function function) const;
+    // Visits only the postings with first_document_id <= id < last_document_id
+    template <typename Function>
+    void ForEachInRange(int first_document_id, int last_document_id, Function function) const;
+
+private:
+    struct Block {
+        int first_document_id = 0;
+        int last_document_id = 0;
+        std::uint16_t count = 0;
+        std::uint8_t bit_width = 0;
+        std::vector<std::uint32_t> packed_deltas;
+        std::vector<std::uint16_t> term_freqs;
+    };
+
+    PostingStorage storage_;
+    std::vector<Block> blocks_;
+    size_t block_postings_count_ = 0;
+    std::vector<int> document_ids_;
+    std::vector<double> term_freqs_;
+    double max_term_freq_ = 0.0;
+    // A view reads its plain postings from these instead of document_ids_ and term_freqs_
+    bool is_view_ = false;
+    const int* view_document_ids_ = nullptr;
+    const double* view_term_freqs_ = nullptr;
+    size_t view_size_ = 0;
+
+    const int* GetPlainDocumentIds() const {
+        return is_view_ ? view_document_ids_ : document_ids_.data();
+    }
+
+    const double* GetPlainTermFreqs() const {
+        return is_view_ ? view_term_freqs_ : term_freqs_.data();
+    }
+
+    size_t GetPlainSize() const {
+        return is_view_ ? view_size_ : document_ids_.size();
+    }
+
+    size_t FindPosition(int document_id) const;
+    size_t FindBlock(int document_id) const;
+    void FlushTail();
+
+    static Block EncodeBlock(const int* document_ids, const std::uint16_t* term_freqs, size_t count);
+    // Unpacks all BLOCK_SIZE slots of the block, with the SSE2 decoder where it is available.
+    // Both decoders must produce the same ids, TestPostingBlockDecoders compares them
+    static void DecodeBlock(const Block& block, int* document_ids);
+    static void DecodeBlockScalar(const Block& block, int* document_ids);
+#if defined(__SSE2__)
+    static void DecodeBlockSse2(const Block& block, int* document_ids);
+#endif
+    static void DecodeBlock(const Block& block, int* document_ids, double* term_freqs);
+    static std::uint16_t QuantizeTermFreq(double term_freq);
+    static double DequantizeTermFreq(std::uint16_t term_freq);
+
+    friend void TestPostingBlockDecoders();
+};
+
+// Walks the postings in document id order and can jump forward to a given id
+class PostingList::Cursor {
+public:
+    explicit Cursor(const PostingList& postings);
+
+    bool IsAtEnd() const {
+        return at_end_;
+    }
+
+    int GetDocumentId() const {
+        return document_id_;
+    }
+
+    double GetTermFreq() const {
+        return term_freq_;
+    }
+
+    void Next();
+    // Moves to the first posting with id >= document_id
+    void SkipTo(int document_id);
+
+private:
+    const PostingList* postings_;
+    size_t block_index_ = 0;  // blocks_.size() when the cursor is in the plain tail
+    size_t position_ = 0;
+    int block_document_ids_[BLOCK_SIZE];
+    double block_term_freqs_[BLOCK_SIZE];
+    int document_id_ = 0;
+    double term_freq_ = 0.0;
+    bool at_end_ = false;
+
+    void LoadBlock();
+    void Settle();
+};
+
+template <typename Function>
+void PostingList::ForEach(Function function) const {
+    int block_document_ids[BLOCK_SIZE];
+    double block_term_freqs[BLOCK_SIZE];
+    for (const Block& block : blocks_) {
+        DecodeBlock(block, block_document_ids, block_term_freqs);
+        for (size_t i = 0; i < block.count; ++i) {
+            function(block_document_ids[i], block_term_freqs[i]);
+        }
+    }
+    const int* const document_ids = GetPlainDocumentIds();
+    const double* const term_freqs = GetPlainTermFreqs();
+    const size_t size = GetPlainSize();
+    for (size_t i = 0; i < size; ++i) {
+        function(document_ids[i], term_freqs[i]);
+    }
+}
+
+template <typename Function>
+void PostingList::ForEachInRange(int first_document_id, int last_document_id, Function function) const {
+    int block_document_ids[BLOCK_SIZE];
+    double block_term_freqs[BLOCK_SIZE];
+    for (auto block = blocks_.begin() + FindBlock(first_document_id);
+         block != blocks_.end() && block->first_document_id < last_document_id; ++block) {
+        DecodeBlock(*block, block_document_ids, block_term_freqs);
+        for (size_t i = 0; i < block->count; ++i) {
+            if (block_document_ids[i] >= first_document_id && block_document_ids[i] < last_document_id) {
+                function(block_document_ids[i], block_term_freqs[i]);
+            }
+        }
+    }
+    const int* const document_ids = GetPlainDocumentIds();
+    const double* const term_freqs = GetPlainTermFreqs();
+    const size_t size = GetPlainSize();
+    for (size_t i = FindPosition(first_document_id); i < size && document_ids[i] < last_document_id; ++i) {
+        function(document_ids[i], term_freqs[i]);
+    }
+}
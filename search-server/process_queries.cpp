@@ -4,6 +4,8 @@
 #include <execution>
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    // Separate queries keep MaxScore pruning and the result cache, which beat the batch path on
+    // text with skewed word frequencies
     std::vector<std::vector<Document>> result(queries.size());
     std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(),
               [&search_server] (const std::string& query)
@@ -12,14 +14,9 @@ std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_ser
 }
 
 std::list<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> result = ProcessQueries(search_server, queries);
-    size_t total_doc_count = 0;
-    for (const std::vector<Document>& docs : result) {
-        total_doc_count += docs.size();
-    }
     std::list<Document> join_documents;
-    for (const auto& docs : result) {
-        join_documents.insert(join_documents.end(), docs.begin(), docs.end());
-    }
+    ProcessQueriesJoined(search_server, queries, [&join_documents](const Document& document) {
+        join_documents.push_back(document);
+    });
     return join_documents;
-}
\ No newline at end of file
+}
@@ -2,9 +2,102 @@
 
 #include "document.h"
 #include "search_server.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <vector>
 #include <list>
+#include <stdexcept>
+#include <string>
+
+// Queries of ProcessQueriesJoined handed to the search server at once
+inline constexpr size_t PROCESS_QUERIES_WINDOW_SIZE = 4096;
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
 
-std::list<Document>  ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
\ No newline at end of file
+std::list<Document>  ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+// Calls callback(document) for the results of all queries, in query order. Queries are searched
+// window_size at a time by one producer thread, which searches the next window while the callback
+// consumes the current one, so at most two windows of results are held at once. An exception of the
+// search or of the callback stops the producer and is rethrown.
+template <typename Callback>
+void ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries,
+                          Callback callback, size_t window_size = PROCESS_QUERIES_WINDOW_SIZE) {
+    using namespace std::string_literals;
+    if (window_size == 0) {
+        throw std::invalid_argument("Window size must be positive"s);
+    }
+    if (queries.empty()) {
+        return;
+    }
+    std::mutex mutex;
+    std::condition_variable changed;
+    // The window searched last, until the consumer takes it
+    std::optional<std::vector<std::vector<Document>>> ready_results;
+    std::exception_ptr search_error;
+    bool is_stopping = false;
+
+    std::thread producer([&] {
+        for (size_t first = 0; first < queries.size(); first += window_size) {
+            {
+                // Waiting before the search keeps the producer one window ahead at most
+                std::unique_lock lock(mutex);
+                changed.wait(lock, [&] {
+                    return !ready_results || is_stopping;
+                });
+                if (is_stopping) {
+                    return;
+                }
+            }
+            std::vector<std::vector<Document>> results;
+            try {
+                results = search_server.FindTopDocumentsBatch(queries.begin() + first,
+                                                              queries.begin() + std::min(first + window_size, queries.size()));
+            } catch (...) {
+                std::lock_guard lock(mutex);
+                search_error = std::current_exception();
+                changed.notify_all();
+                return;
+            }
+            std::lock_guard lock(mutex);
+            ready_results = std::move(results);
+            changed.notify_all();
+        }
+    });
+
+    try {
+        std::vector<std::vector<Document>> results;
+        for (size_t first = 0; first < queries.size(); first += window_size) {
+            {
+                std::unique_lock lock(mutex);
+                changed.wait(lock, [&] {
+                    return ready_results || search_error;
+                });
+                if (search_error) {
+                    std::rethrow_exception(search_error);
+                }
+                results = std::move(*ready_results);
+                ready_results.reset();
+            }
+            changed.notify_all();
+            for (const std::vector<Document>& documents : results) {
+                for (const Document& document : documents) {
+                    callback(document);
+                }
+            }
+        }
+    } catch (...) {
+        {
+            std::lock_guard lock(mutex);
+            is_stopping = true;
+        }
+        changed.notify_all();
+        producer.join();
+        throw;
+    }
+    producer.join();
+}
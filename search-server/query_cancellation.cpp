@@ -0,0 +1,25 @@
+#include "query_cancellation.h"
+
+using namespace std::string_literals;
+
+QueryCancellation::QueryCancellation(Clock::time_point deadline)
+        : deadline_(deadline)
+{
+}
+
+void QueryCancellation::Cancel() {
+    is_cancelled_.store(true, std::memory_order_relaxed);
+}
+
+bool QueryCancellation::IsCancelled() const {
+    if (is_cancelled_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    return deadline_ != Clock::time_point::max() && Clock::now() >= deadline_;
+}
+
+void QueryCancellation::ThrowIfCancelled() const {
+    if (IsCancelled()) {
+        throw QueryCancelledError("Query cancelled"s);
+    }
+}
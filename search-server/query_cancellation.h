@@ -0,0 +1,32 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+// Thrown by a query stopped by its QueryCancellation
+class QueryCancelledError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Stop condition of a running query: a deadline and a flag that any thread can raise with Cancel.
+// The search server checks it between posting lists and periodically within them.
+class QueryCancellation {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    QueryCancellation() = default;
+    explicit QueryCancellation(Clock::time_point deadline);
+
+    void Cancel();
+    // True once cancelled or past the deadline
+    bool IsCancelled() const;
+    // Throws QueryCancelledError if IsCancelled()
+    void ThrowIfCancelled() const;
+
+private:
+    Clock::time_point deadline_ = Clock::time_point::max();
+    std::atomic<bool> is_cancelled_{false};
+};
@@ -0,0 +1,162 @@
+#include "query_executor.h"
+
+using namespace std::string_literals;
+
+QueryExecutor::PendingQuery::PendingQuery(std::future<std::vector<Document>> result, std::shared_ptr<QueryCancellation> cancellation)
+        : result_(std::move(result))
+        , cancellation_(std::move(cancellation))
+{
+}
+
+std::vector<Document> QueryExecutor::PendingQuery::Get() {
+    return result_.get();
+}
+
+void QueryExecutor::PendingQuery::Cancel() {
+    cancellation_->Cancel();
+}
+
+QueryExecutor::QueryExecutor(const SearchServer& search_server, size_t thread_count, size_t max_queued_count)
+        : QueryExecutor([&search_server]() {
+                            // Not owned: the caller keeps the server alive
+                            return std::shared_ptr<const SearchServer>(std::shared_ptr<const SearchServer>(), &search_server);
+                        }, thread_count, max_queued_count)
+{
+}
+
+QueryExecutor::QueryExecutor(const ConcurrentSearchServer& search_server, size_t thread_count, size_t max_queued_count)
+        : QueryExecutor([&search_server]() {
+                            return search_server.GetSnapshot();
+                        }, thread_count, max_queued_count)
+{
+}
+
+QueryExecutor::QueryExecutor(SearchServerSource search_server_source, size_t thread_count, size_t max_queued_count)
+        : search_server_source_(std::move(search_server_source))
+        , max_queued_count_(max_queued_count)
+{
+    if (thread_count == 0) {
+        throw std::invalid_argument("Thread count must be positive"s);
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this, i]() {
+            RunWorker(i);
+        });
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        std::lock_guard guard(sleep_mutex_);
+        is_stopping_.store(true);
+    }
+    has_tasks_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::optional<QueryExecutor::PendingQuery> QueryExecutor::Submit(std::string raw_query, DocumentStatus status,
+                                                                 Clock::time_point deadline, size_t max_result_count) {
+    if (reserved_count_.fetch_add(1) >= max_queued_count_) {
+        reserved_count_.fetch_sub(1);
+        rejected_count_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    auto cancellation = std::make_shared<QueryCancellation>(deadline);
+    Task task{std::move(raw_query), status, max_result_count, cancellation, {}};
+    PendingQuery pending_query(task.result.get_future(), std::move(cancellation));
+
+    WorkerQueue& queue = *queues_[next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size()];
+    {
+        // Counted together with the push: PopTask decrements under the same mutex, so the count never underflows
+        std::lock_guard guard(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+        queued_count_.fetch_add(1);
+    }
+    // A worker counts itself as sleeping before it checks queued_count_ for the last time, so either
+    // it sees the new query or it is seen here. The lock makes sure it is waiting by the notification
+    if (sleeping_count_.load() > 0) {
+        {
+            std::lock_guard guard(sleep_mutex_);
+        }
+        has_tasks_.notify_one();
+    }
+    return pending_query;
+}
+
+QueryExecutor::Stats QueryExecutor::GetStats() const {
+    Stats stats;
+    stats.queued = queued_count_.load();
+    stats.running = running_count_.load();
+    stats.completed = completed_count_.load();
+    stats.rejected = rejected_count_.load();
+    stats.cancelled = cancelled_count_.load();
+    return stats;
+}
+
+void QueryExecutor::RunWorker(size_t worker_index) {
+    while (true) {
+        if (queued_count_.load() == 0) {
+            std::unique_lock lock(sleep_mutex_);
+            sleeping_count_.fetch_add(1);
+            has_tasks_.wait(lock, [this]() {
+                return is_stopping_.load() || queued_count_.load() > 0;
+            });
+            sleeping_count_.fetch_sub(1);
+            if (is_stopping_.load() && queued_count_.load() == 0) {
+                return;
+            }
+        }
+        if (std::optional<Task> task = PopTask(worker_index)) {
+            Run(*task);
+        }
+    }
+}
+
+std::optional<QueryExecutor::Task> QueryExecutor::PopTask(size_t worker_index) {
+    // The owner takes the oldest query of its queue, thieves the newest of the others,
+    // so that they rarely contend for the same end
+    for (size_t i = 0; i < queues_.size(); ++i) {
+        WorkerQueue& queue = *queues_[(worker_index + i) % queues_.size()];
+        std::lock_guard guard(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        std::optional<Task> task;
+        if (i == 0) {
+            task.emplace(std::move(queue.tasks.front()));
+            queue.tasks.pop_front();
+        } else {
+            task.emplace(std::move(queue.tasks.back()));
+            queue.tasks.pop_back();
+        }
+        queued_count_.fetch_sub(1);
+        reserved_count_.fetch_sub(1);
+        return task;
+    }
+    return std::nullopt;
+}
+
+void QueryExecutor::Run(Task& task) {
+    if (is_stopping_.load()) {
+        task.cancellation->Cancel();
+    }
+    running_count_.fetch_add(1);
+    try {
+        // The snapshot is held until the query is done, a write publishes a new one meanwhile
+        const auto search_server = search_server_source_();
+        task.result.set_value(search_server->FindTopDocuments(task.raw_query, task.status, task.max_result_count, *task.cancellation));
+        completed_count_.fetch_add(1, std::memory_order_relaxed);
+    } catch (const QueryCancelledError&) {
+        cancelled_count_.fetch_add(1, std::memory_order_relaxed);
+        task.result.set_exception(std::current_exception());
+    } catch (...) {
+        task.result.set_exception(std::current_exception());
+    }
+    running_count_.fetch_sub(1);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent_search_server.h"
+#include "query_cancellation.h"
+#include "search_server.h"
+
+// Fixed pool of worker threads running FindTopDocuments of a search server. Every worker has its
+// own queue and steals from the others when it runs dry. The total number of waiting queries is
+// bounded: a query submitted to a full executor is rejected instead of waiting, and a query whose
+// deadline passes while it waits is dropped without being searched.
+class QueryExecutor {
+public:
+    using Clock = QueryCancellation::Clock;
+    // Gives the search server a query runs on, called once per query as it starts
+    using SearchServerSource = std::function<std::shared_ptr<const SearchServer>()>;
+
+    struct Stats {
+        size_t queued = 0;
+        size_t running = 0;
+        uint64_t completed = 0;
+        uint64_t rejected = 0;
+        // Cancelled or past the deadline, before or while running
+        uint64_t cancelled = 0;
+    };
+
+    // Result of a submitted query
+    class PendingQuery {
+    public:
+        // Waits for the documents; throws QueryCancelledError if the query was cancelled or
+        // has expired, and rethrows errors of the search (e.g. an invalid query)
+        std::vector<Document> Get();
+        void Cancel();
+
+    private:
+        friend class QueryExecutor;
+        PendingQuery(std::future<std::vector<Document>> result, std::shared_ptr<QueryCancellation> cancellation);
+
+        std::future<std::vector<Document>> result_;
+        std::shared_ptr<QueryCancellation> cancellation_;
+    };
+
+    explicit QueryExecutor(SearchServerSource search_server_source,
+                           size_t thread_count = std::max(1u, std::thread::hardware_concurrency()),
+                           size_t max_queued_count = 1024);
+    // The search server must outlive the executor and must not be changed while queries run
+    explicit QueryExecutor(const SearchServer& search_server,
+                           size_t thread_count = std::max(1u, std::thread::hardware_concurrency()),
+                           size_t max_queued_count = 1024);
+    // Every query runs on the snapshot published when it starts, so writes may go on meanwhile.
+    // The search server must outlive the executor
+    explicit QueryExecutor(const ConcurrentSearchServer& search_server,
+                           size_t thread_count = std::max(1u, std::thread::hardware_concurrency()),
+                           size_t max_queued_count = 1024);
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+    // Queries still waiting are cancelled, running ones are finished
+    ~QueryExecutor();
+
+    // std::nullopt if max_queued_count queries are already waiting
+    std::optional<PendingQuery> Submit(std::string raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                       Clock::time_point deadline = Clock::time_point::max(),
+                                       size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT);
+
+    Stats GetStats() const;
+
+private:
+    struct Task {
+        std::string raw_query;
+        DocumentStatus status;
+        size_t max_result_count;
+        std::shared_ptr<QueryCancellation> cancellation;
+        std::promise<std::vector<Document>> result;
+    };
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    const SearchServerSource search_server_source_;
+    const size_t max_queued_count_;
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    // Slots taken by submitted queries not yet picked by a worker; bounds the queues
+    std::atomic<size_t> reserved_count_{0};
+    // Queries pushed into a queue and not yet picked; idle workers sleep while it is zero
+    std::atomic<size_t> queued_count_{0};
+    std::atomic<size_t> next_queue_{0};
+    std::atomic<size_t> running_count_{0};
+    std::atomic<uint64_t> completed_count_{0};
+    std::atomic<uint64_t> rejected_count_{0};
+    std::atomic<uint64_t> cancelled_count_{0};
+    // Only taken to fall asleep and to wake a sleeper, Submit and Run skip it while all workers are busy
+    std::mutex sleep_mutex_;
+    std::condition_variable has_tasks_;
+    std::atomic<size_t> sleeping_count_{0};
+    std::atomic<bool> is_stopping_{false};
+    std::vector<std::thread> workers_;
+
+    void RunWorker(size_t worker_index);
+    // Takes a task from the worker's own queue, then from the others
+    std::optional<Task> PopTask(size_t worker_index);
+    void Run(Task& task);
+};
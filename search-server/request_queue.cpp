@@ -1,13 +1,199 @@
 #include "request_queue.h"
 
+#include <algorithm>
+#include <thread>
+
+using namespace std::string_literals;
+
+namespace {
+std::atomic<size_t> next_thread_slot{0};
+}
+
+RequestQueue::RequestQueue(const SearchServer& search_server, std::chrono::minutes window)
+        : search_server_(search_server)
+        , window_minutes_(window.count())
+        , first_minute_(ToMinute(Clock::now()))
+{
+    if (window_minutes_ <= 0) {
+        throw std::invalid_argument("Window must be positive"s);
+    }
+    minutes_ = std::make_unique<MinuteBucket[]>(window_minutes_);
+    // One more hour than the window spans, as the window rarely starts at a whole hour
+    hour_count_ = static_cast<size_t>((window_minutes_ + 59) / 60 + 1);
+    hours_ = std::make_unique<HourBucket[]>(hour_count_);
+}
+
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    return AddFindRequest(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-    });
+    const Clock::time_point start = Clock::now();
+    auto result = search_server_.FindTopDocuments(raw_query, status);
+    const Clock::time_point finish = Clock::now();
+    Record(raw_query, result.size(), finish - start, finish);
+    return result;
 }
+
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
     return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
+
+void RequestQueue::Record(const std::string& raw_query, size_t result_count, Clock::duration latency, Clock::time_point now) {
+    const int64_t minute = ToMinute(now);
+    MinuteBucket* bucket_ptr = GetMinuteBucket(minute);
+    if (bucket_ptr == nullptr) {
+        return;
+    }
+    MinuteBucket& bucket = *bucket_ptr;
+    bucket.request_count.fetch_add(1, std::memory_order_relaxed);
+    if (result_count == 0) {
+        bucket.no_result_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    size_t latency_bucket = 0;
+    while (latency_bucket + 1 < LATENCY_BUCKET_COUNT && (microseconds >> (latency_bucket + 1)) > 0) {
+        ++latency_bucket;
+    }
+    bucket.latency_counts[latency_bucket].fetch_add(1, std::memory_order_relaxed);
+    CountQuery(raw_query, minute / 60);
+}
+
 int RequestQueue::GetNoResultRequests() const {
-    return no_results_request_;
-}
\ No newline at end of file
+    return static_cast<int>(GetStats().no_result_count);
+}
+
+RequestQueue::Stats RequestQueue::GetStats() const {
+    return GetStats(std::chrono::minutes(window_minutes_));
+}
+
+RequestQueue::Stats RequestQueue::GetStats(std::chrono::minutes period, size_t top_query_count, Clock::time_point now) const {
+    const int64_t last_minute = ToMinute(now);
+    const int64_t minute_count = std::clamp<int64_t>(period.count(), 1, window_minutes_);
+    const int64_t first_minute = last_minute - minute_count + 1;
+
+    Stats stats;
+    std::array<uint64_t, LATENCY_BUCKET_COUNT> latency_counts{};
+    for (int64_t i = 0; i < window_minutes_; ++i) {
+        const MinuteBucket& bucket = minutes_[i];
+        const int64_t minute = bucket.minute.load(std::memory_order_acquire);
+        if (minute < first_minute || minute > last_minute) {
+            continue;
+        }
+        stats.request_count += bucket.request_count.load(std::memory_order_relaxed);
+        stats.no_result_count += bucket.no_result_count.load(std::memory_order_relaxed);
+        for (size_t j = 0; j < LATENCY_BUCKET_COUNT; ++j) {
+            latency_counts[j] += bucket.latency_counts[j].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Minutes before the queue was created are not part of the rate
+    const int64_t covered_minutes = std::max<int64_t>(1, last_minute - std::max(first_minute, first_minute_) + 1);
+    stats.queries_per_second = static_cast<double>(stats.request_count) / static_cast<double>(covered_minutes * 60);
+    if (stats.request_count > 0) {
+        stats.no_result_rate = static_cast<double>(stats.no_result_count) / static_cast<double>(stats.request_count);
+    }
+    const auto find_percentile = [&](double percentile) {
+        const uint64_t rank = static_cast<uint64_t>(percentile * static_cast<double>(stats.request_count));
+        uint64_t count = 0;
+        for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+            count += latency_counts[i];
+            if (count > rank) {
+                return std::chrono::microseconds(int64_t{1} << (i + 1));
+            }
+        }
+        return std::chrono::microseconds(0);
+    };
+    if (stats.request_count > 0) {
+        stats.latency_p50 = find_percentile(0.5);
+        stats.latency_p90 = find_percentile(0.9);
+        stats.latency_p99 = find_percentile(0.99);
+    }
+
+    std::unordered_map<std::string, uint64_t> query_counts;
+    const int64_t first_hour = first_minute / 60;
+    const int64_t last_hour = last_minute / 60;
+    for (size_t i = 0; i < hour_count_; ++i) {
+        for (TopQuerySketch& sketch : hours_[i].sketches) {
+            std::lock_guard guard(sketch.mutex);
+            if (sketch.hour < first_hour || sketch.hour > last_hour) {
+                continue;
+            }
+            for (const auto& [query, count] : sketch.counts) {
+                query_counts[query] += count;
+            }
+        }
+    }
+    stats.top_queries.assign(query_counts.begin(), query_counts.end());
+    const size_t result_count = std::min(top_query_count, stats.top_queries.size());
+    std::partial_sort(stats.top_queries.begin(), stats.top_queries.begin() + result_count, stats.top_queries.end(),
+                      [](const auto& lhs, const auto& rhs) {
+                          return lhs.second > rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first);
+                      });
+    stats.top_queries.resize(result_count);
+    return stats;
+}
+
+int64_t RequestQueue::ToMinute(Clock::time_point time_point) {
+    return std::chrono::duration_cast<std::chrono::minutes>(time_point.time_since_epoch()).count();
+}
+
+RequestQueue::MinuteBucket* RequestQueue::GetMinuteBucket(int64_t minute) {
+    MinuteBucket& bucket = minutes_[minute % window_minutes_];
+    while (true) {
+        int64_t bucket_minute = bucket.minute.load(std::memory_order_acquire);
+        if (bucket_minute == minute) {
+            return &bucket;
+        }
+        // A late recording of a minute whose bucket has moved on is out of the window
+        if (bucket_minute > minute) {
+            return nullptr;
+        }
+        if (bucket_minute == RESETTING) {
+            std::this_thread::yield();
+            continue;
+        }
+        // The thread winning the swap clears the counters of the old minute, the others wait for it
+        if (bucket.minute.compare_exchange_weak(bucket_minute, RESETTING, std::memory_order_acquire)) {
+            bucket.request_count.store(0, std::memory_order_relaxed);
+            bucket.no_result_count.store(0, std::memory_order_relaxed);
+            for (auto& count : bucket.latency_counts) {
+                count.store(0, std::memory_order_relaxed);
+            }
+            bucket.minute.store(minute, std::memory_order_release);
+            return &bucket;
+        }
+    }
+}
+
+size_t RequestQueue::GetThreadSlot() {
+    static thread_local const size_t slot = next_thread_slot.fetch_add(1, std::memory_order_relaxed) % TOP_QUERY_SKETCH_COUNT;
+    return slot;
+}
+
+void RequestQueue::CountQuery(const std::string& raw_query, int64_t hour) {
+    TopQuerySketch& sketch = hours_[hour % hour_count_].sketches[GetThreadSlot()];
+    std::lock_guard guard(sketch.mutex);
+    if (sketch.hour != hour) {
+        if (sketch.hour > hour) {
+            return;
+        }
+        sketch.hour = hour;
+        sketch.counts.clear();
+        sketch.by_count.clear();
+    }
+    if (const auto it = sketch.counts.find(raw_query); it != sketch.counts.end()) {
+        auto node = sketch.by_count.extract({it->second, &it->first});
+        node.value().first = ++it->second;
+        sketch.by_count.insert(std::move(node));
+        return;
+    }
+    if (sketch.counts.size() < TOP_QUERY_SKETCH_CAPACITY) {
+        const auto it = sketch.counts.emplace(raw_query, 1).first;
+        sketch.by_count.emplace(1, &it->first);
+        return;
+    }
+    // The nodes of the least counted query are reused, so the key pointer stays valid
+    auto least_counted = sketch.by_count.extract(sketch.by_count.begin());
+    auto entry = sketch.counts.extract(*least_counted.value().second);
+    entry.key() = raw_query;
+    entry.mapped() = ++least_counted.value().first;
+    sketch.counts.insert(std::move(entry));
+    sketch.by_count.insert(std::move(least_counted));
+}
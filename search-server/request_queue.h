@@ -1,42 +1,109 @@
 #pragma once
 
-#include <deque>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "search_server.h"
 
+// Sliding-window statistics of the queries sent to a search server: request rate, share of
+// requests without results, latency percentiles and the most frequent queries. Counters live in
+// a ring of per-minute buckets updated with atomics, so many query threads may record at once
+// without a shared lock. Recordings older than the minute a bucket has moved on to are dropped.
+// Top queries are counted per hour in small sketches, one per recording thread slot, merged by GetStats.
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server)
-            : search_server_(search_server)
-            , no_results_request_(0)
-    {
-    }
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t request_count = 0;
+        uint64_t no_result_count = 0;
+        double queries_per_second = 0.0;
+        double no_result_rate = 0.0;
+        // Upper bounds of the latency histogram buckets holding the percentiles
+        std::chrono::microseconds latency_p50{0};
+        std::chrono::microseconds latency_p90{0};
+        std::chrono::microseconds latency_p99{0};
+        // Most frequent queries, most frequent first; counts are estimates from a bounded sketch
+        std::vector<std::pair<std::string, uint64_t>> top_queries;
+    };
+
+    // window is how far back the statistics reach, one day by default
+    explicit RequestQueue(const SearchServer& search_server, std::chrono::minutes window = std::chrono::minutes(1440));
+
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
     std::vector<Document> AddFindRequest(const std::string& raw_query);
+
+    // Records a query run elsewhere, e.g. on a QueryExecutor
+    void Record(const std::string& raw_query, size_t result_count, Clock::duration latency, Clock::time_point now = Clock::now());
+
+    // Requests without results within the window
     int GetNoResultRequests() const;
+    // Statistics of the last period (at most the window); top queries are counted by whole hours
+    Stats GetStats(std::chrono::minutes period, size_t top_query_count = 10, Clock::time_point now = Clock::now()) const;
+    Stats GetStats() const;
+
 private:
-    struct QueryResult {
-        int result_count;
+    // Bucket i counts latencies in [2^i, 2^(i+1)) microseconds, the first one also shorter ones
+    static constexpr size_t LATENCY_BUCKET_COUNT = 32;
+    static constexpr size_t TOP_QUERY_SKETCH_COUNT = 16;
+    static constexpr size_t TOP_QUERY_SKETCH_CAPACITY = 64;
+    // Minute of a bucket being reset by a recording thread
+    static constexpr int64_t RESETTING = -1;
+
+    struct MinuteBucket {
+        // Minute the counters belong to, RESETTING or -2 while never used
+        std::atomic<int64_t> minute{-2};
+        std::atomic<uint64_t> request_count{0};
+        std::atomic<uint64_t> no_result_count{0};
+        std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT> latency_counts{};
+    };
+    // Space-Saving sketch: keeps the queries with the highest counts, a newcomer replaces the
+    // least counted one and inherits its count. The mutex is only contended by GetStats and by
+    // threads sharing a slot.
+    struct TopQuerySketch {
+        std::mutex mutex;
+        int64_t hour = -1;
+        std::unordered_map<std::string, uint64_t> counts;
+        // (count, query) of every entry of counts, the least counted first; queries point to keys of counts
+        std::set<std::pair<uint64_t, const std::string*>> by_count;
     };
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
+    struct HourBucket {
+        std::array<TopQuerySketch, TOP_QUERY_SKETCH_COUNT> sketches;
+    };
+
     const SearchServer& search_server_;
-    int no_results_request_;
+    const int64_t window_minutes_;
+    const int64_t first_minute_;
+    std::unique_ptr<MinuteBucket[]> minutes_;
+    std::unique_ptr<HourBucket[]> hours_;
+    size_t hour_count_;
+
+    static int64_t ToMinute(Clock::time_point time_point);
+    // The bucket of the minute, reset first if it still holds an older minute;
+    // nullptr if it has already moved on to a newer one
+    MinuteBucket* GetMinuteBucket(int64_t minute);
+    // Sketch slot of the calling thread, fixed for its lifetime
+    static size_t GetThreadSlot();
+    void CountQuery(const std::string& raw_query, int64_t hour);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+    const Clock::time_point start = Clock::now();
     auto result = search_server_.FindTopDocuments(std::execution::seq, std::string_view(raw_query), document_predicate);
-    if (requests_.size() >= min_in_day_) {
-        requests_.pop_front();
-        --no_results_request_;
-    }
-    requests_.push_front({static_cast<int>(requests_.size())});
-    if (result.empty()) {
-        ++no_results_request_;
-    }
+    const Clock::time_point finish = Clock::now();
+    Record(raw_query, result.size(), finish - start, finish);
     return result;
-}
\ No newline at end of file
+}
@@ -0,0 +1,111 @@
+#include "result_cache.h"
+
+#include <stdexcept>
+#include <string>
+
+using namespace std::string_literals;
+
+bool ResultCache::Key::operator==(const Key& other) const {
+    return status == other.status && max_result_count == other.max_result_count
+           && plus_words == other.plus_words && minus_words == other.minus_words;
+}
+
+size_t ResultCache::KeyHasher::operator()(const Key& key) const {
+    // 64-bit FNV-1a over the terms, with a separator between plus and minus words
+    uint64_t hash = 14695981039346656037ULL;
+    const auto mix = [&hash](uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ULL;
+    };
+    for (const TermId term : key.plus_words) {
+        mix(term);
+    }
+    mix(TermDictionary::NO_TERM);
+    for (const TermId term : key.minus_words) {
+        mix(term);
+    }
+    mix(static_cast<uint64_t>(key.status));
+    mix(key.max_result_count);
+    return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+ResultCache::ResultCache(size_t memory_budget, size_t shard_count) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    shard_memory_budget_ = memory_budget / shard_count;
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+bool ResultCache::Find(const Key& key, uint64_t generation, std::vector<Document>& documents) const {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto it = shard.entries.find(key);
+    if (it == shard.entries.end() || it->second.generation != generation) {
+        if (it != shard.entries.end()) {
+            Erase(shard, it);
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    shard.recency.splice(shard.recency.begin(), shard.recency, it->second.recency);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    documents.assign(it->second.documents.begin(), it->second.documents.end());
+    return true;
+}
+
+void ResultCache::Insert(const Key& key, uint64_t generation, const std::vector<Document>& documents) {
+    const size_t memory_usage = ComputeMemoryUsage(key, documents);
+    if (memory_usage > shard_memory_budget_) {
+        return;
+    }
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    if (const auto it = shard.entries.find(key); it != shard.entries.end()) {
+        Erase(shard, it);
+    }
+    while (shard.memory_usage + memory_usage > shard_memory_budget_) {
+        Erase(shard, shard.entries.find(*shard.recency.back()));
+    }
+    const auto it = shard.entries.emplace(key, Entry{documents, generation, memory_usage, {}}).first;
+    shard.recency.push_front(&it->first);
+    it->second.recency = shard.recency.begin();
+    shard.memory_usage += memory_usage;
+}
+
+size_t ResultCache::GetMemoryBudget() const {
+    return shard_memory_budget_ * shards_.size();
+}
+
+ResultCache::Stats ResultCache::GetStats() const {
+    Stats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    for (const auto& shard : shards_) {
+        std::lock_guard guard(shard->mutex);
+        stats.entry_count += shard->entries.size();
+        stats.memory_usage += shard->memory_usage;
+    }
+    return stats;
+}
+
+ResultCache::Shard& ResultCache::GetShard(const Key& key) const {
+    // The low bits pick the bucket inside the shard, the shard is picked by the high ones
+    return *shards_[(KeyHasher{}(key) >> 16) % shards_.size()];
+}
+
+size_t ResultCache::ComputeMemoryUsage(const Key& key, const std::vector<Document>& documents) {
+    // Approximate: payloads plus a fixed allowance for the hash and list nodes
+    constexpr size_t NODE_OVERHEAD = 64;
+    return sizeof(Key) + sizeof(Entry) + NODE_OVERHEAD
+           + (key.plus_words.size() + key.minus_words.size()) * sizeof(TermId)
+           + documents.size() * sizeof(Document);
+}
+
+void ResultCache::Erase(Shard& shard, std::unordered_map<Key, Entry, KeyHasher>::iterator it) {
+    shard.memory_usage -= it->second.memory_usage;
+    shard.recency.erase(it->second.recency);
+    shard.entries.erase(it);
+}
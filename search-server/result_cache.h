@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "term_dictionary.h"
+
+// LRU cache of query results keyed by the parsed query. Entries remember the index generation
+// they were computed at and count as misses once the generation has moved on. The cache is
+// split into shards with a lock each, and the memory budget is shared equally between them.
+class ResultCache {
+public:
+    // Parsed query: plus and minus terms sorted and without duplicates
+    struct Key {
+        std::vector<TermId> plus_words;
+        std::vector<TermId> minus_words;
+        DocumentStatus status;
+        size_t max_result_count;
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t entry_count = 0;
+        size_t memory_usage = 0;
+    };
+
+    explicit ResultCache(size_t memory_budget, size_t shard_count = 16);
+
+    // On a hit the cached result is copied into documents
+    bool Find(const Key& key, uint64_t generation, std::vector<Document>& documents) const;
+    void Insert(const Key& key, uint64_t generation, const std::vector<Document>& documents);
+
+    Stats GetStats() const;
+    size_t GetMemoryBudget() const;
+
+private:
+    struct KeyHasher {
+        size_t operator()(const Key& key) const;
+    };
+    struct Entry {
+        std::vector<Document> documents;
+        uint64_t generation;
+        size_t memory_usage;
+        // Position in the recency list of the shard
+        std::list<const Key*>::iterator recency;
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Key, Entry, KeyHasher> entries;
+        // Most recently used first; points to the keys stored in entries
+        std::list<const Key*> recency;
+        size_t memory_usage = 0;
+    };
+
+    size_t shard_memory_budget_;
+    // Shards are found by the key hash and changed by const lookups, e.g. to refresh recency
+    mutable std::vector<std::unique_ptr<Shard>> shards_;
+    mutable std::atomic<uint64_t> hits_{0};
+    mutable std::atomic<uint64_t> misses_{0};
+
+    Shard& GetShard(const Key& key) const;
+    static size_t ComputeMemoryUsage(const Key& key, const std::vector<Document>& documents);
+    // Caller holds the shard lock
+    static void Erase(Shard& shard, std::unordered_map<Key, Entry, KeyHasher>::iterator it);
+};
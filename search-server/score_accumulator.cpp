@@ -0,0 +1,18 @@
+#include "score_accumulator.h"
+
+ScoreAccumulator& ScoreAccumulator::GetForCurrentThread() {
+    static thread_local ScoreAccumulator accumulator;
+    return accumulator;
+}
+
+void ScoreAccumulator::Prepare(size_t size) {
+    for (const std::uint32_t ordinal : touched_) {
+        scores_[ordinal] = 0.0;
+        flags_[ordinal] = 0;
+    }
+    touched_.clear();
+    if (scores_.size() < size) {
+        scores_.resize(size, 0.0);
+        flags_.resize(size, 0);
+    }
+}
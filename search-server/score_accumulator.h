@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Dense relevance table indexed by document ordinal. Slots touched by a query are
+// remembered, so the table is reset in O(touched) and one instance per thread
+// can be reused by every query that thread runs.
+class ScoreAccumulator {
+public:
+    // The table of the calling thread. A query must not start another query on the
+    // same thread (e.g. from a document predicate) while it holds the table.
+    static ScoreAccumulator& GetForCurrentThread();
+
+    // Resets the previous query and makes room for ordinals in [0, size)
+    void Prepare(size_t size);
+
+    bool IsScored(size_t ordinal) const {
+        return flags_[ordinal] & SCORED;
+    }
+
+    bool IsExcluded(size_t ordinal) const {
+        return flags_[ordinal] & EXCLUDED;
+    }
+
+    void Add(size_t ordinal, double relevance) {
+        Touch(ordinal, SCORED);
+        scores_[ordinal] += relevance;
+    }
+
+    void Exclude(size_t ordinal) {
+        Touch(ordinal, EXCLUDED);
+    }
+
+    // Calls function(ordinal, relevance) for every scored and not excluded ordinal
+    template <typename Function>
+    void ForEachScored(Function function) const;
+
+private:
+    enum Flag : std::uint8_t {
+        SCORED = 1,
+        EXCLUDED = 2,
+    };
+
+    std::vector<double> scores_;
+    std::vector<std::uint8_t> flags_;
+    std::vector<std::uint32_t> touched_;
+
+    void Touch(size_t ordinal, Flag flag) {
+        if (flags_[ordinal] == 0) {
+            touched_.push_back(static_cast<std::uint32_t>(ordinal));
+        }
+        flags_[ordinal] |= flag;
+    }
+};
+
+template <typename Function>
+void ScoreAccumulator::ForEachScored(Function function) const {
+    for (const std::uint32_t ordinal : touched_) {
+        if (flags_[ordinal] == SCORED) {
+            function(ordinal, scores_[ordinal]);
+        }
+    }
+}
@@ -1,34 +1,273 @@
 #include "search_server.h"
 
+#include "snapshot_reader.h"
+#include "snapshot_writer.h"
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+// Version 2 added the posting partitioning after the posting storage, version 3 keeps
+// a posting list per posting key instead of one per term
+constexpr std::uint32_t SNAPSHOT_VERSION = 3;
+
+}  // namespace
+
 void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
     if ((document_id < 0) || (document_ids_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id"s);
     }
-    std::deque<std::string> storage;
-    storage.emplace_back(document);
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, storage});
-    const auto words = SplitIntoWordsNoStop(documents_.at(document_id).string_storage.back());
+    // Words are interned into the dictionary, so the document text itself is not kept
+    const auto& words = SplitIntoWordsNoStop(document);
+    auto& document_data = documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, static_cast<int>(ordinal_to_document_id_.size())}).first->second;
 
     const double inv_word_count = 1.0 / static_cast<double>(words.size());
+    std::map<TermId, double> term_freqs;
     for (const std::string_view word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        word_freqs_[document_id][word] += inv_word_count;
+        term_freqs[terms_.Intern(word)] += inv_word_count;
     }
+    word_to_document_freqs_.resize(terms_.GetSize() * GetPartitionCount(), PostingList(posting_storage_));
+    document_freqs_.resize(terms_.GetSize());
+    log_document_freqs_.resize(terms_.GetSize());
+
+    document_data.terms_storage.reserve(term_freqs.size());
+    document_data.term_freqs_storage.reserve(term_freqs.size());
+    for (const auto [term, term_freq] : term_freqs) {
+        word_to_document_freqs_[GetPostingKey(term, status)].Add(document_data.ordinal, term_freq);
+        ++document_freqs_[term];
+        UpdateLogDocumentFreq(term);
+        document_data.terms_storage.push_back(term);
+        document_data.term_freqs_storage.push_back(term_freq);
+    }
+    document_data.UseStorage();
 
     document_ids_.insert(document_id);
+    ordinal_to_document_id_.push_back(document_id);
+    ordinal_statuses_.push_back(status);
+    ordinal_ratings_.push_back(document_data.rating);
+    UpdateLogDocumentCount();
+    SealWriteBufferIfFull();
+}
 
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    AddDocumentBatch(std::execution::seq, documents);
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-    });
+void SearchServer::AddDocuments(std::execution::sequenced_policy, const std::vector<NewDocument>& documents) {
+    AddDocumentBatch(std::execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(std::execution::parallel_policy, const std::vector<NewDocument>& documents) {
+    AddDocumentBatch(std::execution::par, documents);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t max_result_count) const {
+    return FindTopDocuments(QueryContext::GetForCurrentThread(), raw_query, status, max_result_count);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t max_result_count,
+                                                     const QueryCancellation& cancellation) const {
+    cancellation.ThrowIfCancelled();
+    auto& context = QueryContext::GetForCurrentThread();
+    ParseQuery(raw_query, context.words_, context.query_);
+    FindTopDocumentsCached(context, status, max_result_count, &cancellation);
+    return context.documents_;
+}
+
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, const std::string_view raw_query,
+                                                            DocumentStatus status, size_t max_result_count) const {
+    ParseQuery(raw_query, context.words_, context.query_);
+    FindTopDocumentsCached(context, status, max_result_count);
+    return context.documents_;
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+                                                                       DocumentStatus status, size_t max_result_count) const {
+    return FindTopDocumentsBatch(raw_queries.begin(), raw_queries.end(), status, max_result_count);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(std::vector<std::string>::const_iterator first,
+                                                                       std::vector<std::string>::const_iterator last,
+                                                                       DocumentStatus status, size_t max_result_count) const {
+    struct ParsedQuery {
+        Query query;
+        std::exception_ptr error;
+    };
+    std::vector<ParsedQuery> parsed_queries(last - first);
+    std::transform(std::execution::par, first, last, parsed_queries.begin(),
+                   [this](const std::string& raw_query) {
+                       ParsedQuery parsed;
+                       try {
+                           parsed.query = ParseQuery(raw_query);
+                       } catch (...) {
+                           parsed.error = std::current_exception();
+                       }
+                       return parsed;
+                   });
+    std::vector<Query> queries;
+    queries.reserve(parsed_queries.size());
+    for (ParsedQuery& parsed : parsed_queries) {
+        if (parsed.error) {
+            std::rethrow_exception(parsed.error);
+        }
+        queries.push_back(std::move(parsed.query));
+    }
+
+    // Queries are scored in groups of neighbours whose decoded postings fit into BATCH_POSTING_BUDGET;
+    // the bound is the document frequency of every distinct term of the group
+    std::vector<std::vector<Document>> results(queries.size());
+    std::vector<bool> is_group_term(terms_.GetSize(), false);
+    std::vector<TermId> batch_terms;
+    size_t first_query = 0;
+    while (first_query < queries.size()) {
+        batch_terms.clear();
+        size_t posting_count = 0;
+        size_t last_query = first_query;
+        for (; last_query < queries.size(); ++last_query) {
+            const Query& query = queries[last_query];
+            size_t query_posting_count = 0;
+            for (const auto* words : {&query.plus_words, &query.minus_words}) {
+                for (const TermId term : *words) {
+                    query_posting_count += is_group_term[term] ? 0 : static_cast<size_t>(document_freqs_[term]);
+                }
+            }
+            if (last_query > first_query && posting_count + query_posting_count > BATCH_POSTING_BUDGET) {
+                break;
+            }
+            posting_count += query_posting_count;
+            for (const auto* words : {&query.plus_words, &query.minus_words}) {
+                for (const TermId term : *words) {
+                    if (!is_group_term[term]) {
+                        is_group_term[term] = true;
+                        batch_terms.push_back(term);
+                    }
+                }
+            }
+        }
+        for (const TermId term : batch_terms) {
+            is_group_term[term] = false;
+        }
+        std::sort(batch_terms.begin(), batch_terms.end());
+        FindTopDocumentsBatchGroup(queries, first_query, last_query, batch_terms, status, max_result_count, results);
+        first_query = last_query;
+    }
+    return results;
+}
+
+void SearchServer::FindTopDocumentsBatchGroup(const std::vector<Query>& queries, size_t first_query, size_t last_query,
+                                              const std::vector<TermId>& batch_terms, DocumentStatus status, size_t max_result_count,
+                                              std::vector<std::vector<Document>>& results) const {
+    // Postings of a term are decoded from all segments once, removed documents and, with partitioning,
+    // documents of other statuses left out
+    struct DecodedPostings {
+        std::vector<int> ordinals;
+        std::vector<double> term_freqs;
+    };
+    const auto segments = segments_->GetSegments();
+    const OrdinalRange all_ordinals = {0, static_cast<int>(ordinal_to_document_id_.size())};
+    std::vector<DecodedPostings> decoded_postings(batch_terms.size());
+    std::transform(std::execution::par, batch_terms.begin(), batch_terms.end(), decoded_postings.begin(),
+                   [&](const TermId term) {
+                       DecodedPostings decoded;
+                       decoded.ordinals.reserve(document_freqs_[term]);
+                       decoded.term_freqs.reserve(document_freqs_[term]);
+                       ForEachPostings(segments, term, status, all_ordinals, [&](const PostingList& postings) {
+                           postings.ForEach([&](int ordinal, double term_freq) {
+                               if (!segments_->IsRemoved(ordinal)) {
+                                   decoded.ordinals.push_back(ordinal);
+                                   decoded.term_freqs.push_back(term_freq);
+                               }
+                           });
+                       });
+                       return decoded;
+                   });
+    const auto find_decoded_postings = [&](const TermId term) -> const DecodedPostings& {
+        return decoded_postings[std::lower_bound(batch_terms.begin(), batch_terms.end(), term) - batch_terms.begin()];
+    };
+
+    std::transform(std::execution::par, queries.begin() + first_query, queries.begin() + last_query, results.begin() + first_query,
+                   [&](const Query& query) {
+                       auto& document_to_relevance = ScoreAccumulator::GetForCurrentThread();
+                       document_to_relevance.Prepare(all_ordinals.last);
+                       for (const TermId term : query.minus_words) {
+                           for (const int ordinal : find_decoded_postings(term).ordinals) {
+                               document_to_relevance.Exclude(ordinal);
+                           }
+                       }
+                       for (const TermId term : query.plus_words) {
+                           if (document_freqs_[term] == 0) {
+                               continue;
+                           }
+                           const double inverse_document_freq = ComputeWordInverseDocumentFreq(term);
+                           const DecodedPostings& decoded = find_decoded_postings(term);
+                           for (size_t i = 0; i < decoded.ordinals.size(); ++i) {
+                               const int ordinal = decoded.ordinals[i];
+                               if (document_to_relevance.IsExcluded(ordinal)) {
+                                   continue;
+                               }
+                               if (!document_to_relevance.IsScored(ordinal) && ordinal_statuses_[ordinal] != status) {
+                                   document_to_relevance.Exclude(ordinal);
+                                   continue;
+                               }
+                               document_to_relevance.Add(ordinal, decoded.term_freqs[i] * inverse_document_freq);
+                           }
+                       }
+
+                       // Only the kept documents are stored, in a vector of their exact size
+                       TopDocuments top_documents(max_result_count);
+                       document_to_relevance.ForEachScored([&](size_t ordinal, double relevance) {
+                           top_documents.Add({ordinal_to_document_id_[ordinal], relevance, ordinal_ratings_[ordinal]});
+                       });
+                       std::vector<Document> documents = top_documents.Extract();
+                       documents.shrink_to_fit();
+                       return documents;
+                   });
+}
+
+SearchServer::SearchServer(const SearchServer& other)
+        : stop_words_(other.stop_words_)
+        , posting_storage_(other.posting_storage_)
+        , posting_partitioning_(other.posting_partitioning_)
+        , terms_(other.terms_)
+        , word_to_document_freqs_(other.word_to_document_freqs_)
+        , buffer_first_ordinal_(other.buffer_first_ordinal_)
+        , segments_(std::make_unique<SegmentSet>(*other.segments_))
+        , document_freqs_(other.document_freqs_)
+        , log_document_freqs_(other.log_document_freqs_)
+        , log_document_count_(other.log_document_count_)
+        , documents_(other.documents_)
+        , document_ids_(other.document_ids_)
+        , ordinal_to_document_id_(other.ordinal_to_document_id_)
+        , ordinal_statuses_(other.ordinal_statuses_)
+        , ordinal_ratings_(other.ordinal_ratings_)
+        , result_cache_(other.result_cache_ ? std::make_unique<ResultCache>(other.result_cache_->GetMemoryBudget()) : nullptr)
+        , snapshot_(other.snapshot_)
+        , generation_(other.generation_)
+{
+    // Terms of documents loaded from a snapshot stay in the shared mapped file
+    for (auto& [document_id, document_data] : documents_) {
+        if (!document_data.terms_storage.empty()) {
+            document_data.UseStorage();
+        }
+    }
+}
+
+void SearchServer::EnableResultCache(size_t memory_budget) {
+    result_cache_ = std::make_unique<ResultCache>(memory_budget);
+}
+
+ResultCache::Stats SearchServer::GetResultCacheStats() const {
+    return result_cache_ ? result_cache_->GetStats() : ResultCache::Stats{};
+}
+
+SearchServer::QueryContext& SearchServer::QueryContext::GetForCurrentThread() {
+    static thread_local QueryContext context;
+    return context;
+}
+
 int SearchServer::GetDocumentCount() const {
     return static_cast<int>(documents_.size());
 }
@@ -43,22 +282,40 @@ std::set<int>::const_iterator SearchServer::end() const {
 
 const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
     static const std::map<std::string_view, double> empty_map = {};
-    if (!word_freqs_.count(document_id)) {
+    const auto document = documents_.find(document_id);
+    if (document == documents_.end()) {
         return empty_map;
-    } else {
-        return word_freqs_.at(document_id);
     }
+    // Concurrent readers may ask for the same document; map nodes stay in place as others are added
+    std::lock_guard lock(*word_freqs_mutex_);
+    const auto [it, is_new] = word_freqs_.try_emplace(document_id);
+    if (is_new) {
+        const DocumentData& document_data = document->second;
+        for (size_t i = 0; i < document_data.term_count; ++i) {
+            it->second.emplace(terms_.GetWord(document_data.terms[i]), document_data.term_freqs[i]);
+        }
+    }
+    return it->second;
+}
+
+void SearchServer::EraseWordFrequencies(int document_id) {
+    std::lock_guard lock(*word_freqs_mutex_);
+    word_freqs_.erase(document_id);
 }
 
 void SearchServer::RemoveDocument(int document_id){
     if (document_ids_.count(document_id)) {
+        // Postings stay in place and are skipped until the segment holding them is merged
+        const auto& document_data = documents_.at(document_id);
+        segments_->MarkRemoved(document_data.ordinal);
+        for (size_t i = 0; i < document_data.term_count; ++i) {
+            --document_freqs_[document_data.terms[i]];
+            UpdateLogDocumentFreq(document_data.terms[i]);
+        }
         documents_.erase(document_id);
         document_ids_.erase(document_id);
-
-        for (auto& [word, freqs] : word_freqs_.at(document_id)) {
-            word_to_document_freqs_.at(word).erase(document_id);
-        }
-        word_freqs_.erase(document_id);
+        EraseWordFrequencies(document_id);
+        UpdateLogDocumentCount();
     }
 }
 
@@ -68,43 +325,346 @@ void SearchServer::RemoveDocument(std::execution::sequenced_policy, int document
 
 void SearchServer::RemoveDocument(std::execution::parallel_policy, int document_id){
     if (document_ids_.count(document_id)) {
+        // Every term of a document is unique, so each task touches its own counters
+        const auto& document_data = documents_.at(document_id);
+        segments_->MarkRemoved(document_data.ordinal);
+        std::for_each(std::execution::par, document_data.terms, document_data.terms + document_data.term_count,
+                      [&] (const TermId term) {
+                          --document_freqs_[term];
+                          UpdateLogDocumentFreq(term);
+                      });
         documents_.erase(document_id);
         document_ids_.erase(document_id);
-        auto& words_rel_to_remove = word_freqs_.at(document_id);
-        std::vector<const std::string_view*> only_words_to_remove(word_freqs_.at(document_id).size());
-        std::transform(std::execution::par, words_rel_to_remove.begin(), words_rel_to_remove.end(), only_words_to_remove.begin(),
-                       [] (auto& words) {return &words.first;});
-        std::for_each(std::execution::par, only_words_to_remove.begin(), only_words_to_remove.end(),
-                      [&] (const auto& word) {word_to_document_freqs_.at(*word).erase(document_id);});
-        word_freqs_.erase(document_id);
+        EraseWordFrequencies(document_id);
+        UpdateLogDocumentCount();
     }
 }
 
-SearchServer::MatchDocuments SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
-    if (document_ids_.count(document_id) == 0) {
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    std::vector<int> ordinals;
+    std::vector<TermId> touched_terms;
+    for (const int document_id : document_ids) {
+        const auto it = documents_.find(document_id);
+        if (it == documents_.end()) {
+            continue;
+        }
+        ordinals.push_back(it->second.ordinal);
+        const DocumentData& document_data = it->second;
+        for (size_t i = 0; i < document_data.term_count; ++i) {
+            --document_freqs_[document_data.terms[i]];
+            touched_terms.push_back(document_data.terms[i]);
+        }
+        documents_.erase(it);
+        document_ids_.erase(document_id);
+        EraseWordFrequencies(document_id);
+    }
+    segments_->MarkRemoved(ordinals);
+    std::sort(touched_terms.begin(), touched_terms.end());
+    touched_terms.erase(std::unique(touched_terms.begin(), touched_terms.end()), touched_terms.end());
+    for (const TermId term : touched_terms) {
+        UpdateLogDocumentFreq(term);
+    }
+    UpdateLogDocumentCount();
+}
+
+void SearchServer::SetDocumentStatus(int document_id, DocumentStatus status) {
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
         throw std::out_of_range("Invalid document_id"s);
     }
-    const auto query = ParseQuery(raw_query);
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    DocumentData& document_data = it->second;
+    if (document_data.status == status) {
+        return;
+    }
+    document_data.status = status;
+    if (posting_partitioning_ == PostingPartitioning::NONE) {
+        ordinal_statuses_[document_data.ordinal] = status;
+        // Cached results depend on statuses too
+        UpdateLogDocumentCount();
+        return;
+    }
+
+    // The document is re-added under a new ordinal, its document frequencies stay as they are
+    segments_->MarkRemoved(document_data.ordinal);
+    document_data.ordinal = static_cast<int>(ordinal_to_document_id_.size());
+    ordinal_to_document_id_.push_back(document_id);
+    ordinal_statuses_.push_back(status);
+    ordinal_ratings_.push_back(document_data.rating);
+    for (size_t i = 0; i < document_data.term_count; ++i) {
+        word_to_document_freqs_[GetPostingKey(document_data.terms[i], status)].Add(document_data.ordinal, document_data.term_freqs[i]);
+    }
+    UpdateLogDocumentCount();
+    SealWriteBufferIfFull();
+}
+
+void SearchServer::CompactIndex() {
+    // new_ordinals[o] is the number of live ordinals before o, which becomes the ordinal of o
+    const int ordinal_count = static_cast<int>(ordinal_to_document_id_.size());
+    std::vector<int> new_ordinals(ordinal_count + 1, 0);
+    for (int ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        new_ordinals[ordinal + 1] = new_ordinals[ordinal] + (segments_->IsRemoved(ordinal) ? 0 : 1);
+    }
+    if (new_ordinals.back() == ordinal_count) {
+        return;
+    }
+
+    std::for_each(std::execution::par, word_to_document_freqs_.begin(), word_to_document_freqs_.end(),
+                  [&](PostingList& postings) {
+                      if (postings.IsEmpty()) {
+                          return;
+                      }
+                      std::vector<int> document_ids;
+                      std::vector<double> term_freqs;
+                      postings.ForEach([&](int ordinal, double term_freq) {
+                          if (new_ordinals[ordinal + 1] != new_ordinals[ordinal]) {
+                              document_ids.push_back(new_ordinals[ordinal]);
+                              term_freqs.push_back(term_freq);
+                          }
+                      });
+                      postings = PostingList(posting_storage_);
+                      postings.Append(document_ids.data(), term_freqs.data(), document_ids.size());
+                  });
+    segments_->Compact(new_ordinals);
+
+    // Live ordinals only move down, so the tables are compacted in place
+    for (int ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        if (new_ordinals[ordinal + 1] != new_ordinals[ordinal]) {
+            const int new_ordinal = new_ordinals[ordinal];
+            ordinal_to_document_id_[new_ordinal] = ordinal_to_document_id_[ordinal];
+            ordinal_statuses_[new_ordinal] = ordinal_statuses_[ordinal];
+            ordinal_ratings_[new_ordinal] = ordinal_ratings_[ordinal];
+        }
+    }
+    const size_t live_count = new_ordinals.back();
+    ordinal_to_document_id_.resize(live_count);
+    ordinal_to_document_id_.shrink_to_fit();
+    ordinal_statuses_.resize(live_count);
+    ordinal_statuses_.shrink_to_fit();
+    ordinal_ratings_.resize(live_count);
+    ordinal_ratings_.shrink_to_fit();
+    for (auto& [document_id, document_data] : documents_) {
+        document_data.ordinal = new_ordinals[document_data.ordinal];
+    }
+    buffer_first_ordinal_ = new_ordinals[buffer_first_ordinal_];
+}
+
+// Snapshot layout: header, stop words, dictionary words in term id order, documents in ordinal
+// order (ids, ratings, statuses, then the terms and term frequencies of all documents), and a
+// posting list per posting key. Ordinals are renumbered densely, which drops the removed documents.
+// Every array is aligned, so that a loaded snapshot is read in place.
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    SnapshotWriter writer(path);
+    writer.WriteArray(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    writer.Write(SNAPSHOT_VERSION);
+    writer.Write(static_cast<std::uint32_t>(posting_storage_));
+    writer.Write(static_cast<std::uint32_t>(posting_partitioning_));
+
+    writer.Write(static_cast<std::uint64_t>(stop_words_.GetSize()));
+    for (const std::string& stop_word : stop_words_) {
+        writer.WriteString(stop_word);
+    }
+    writer.Write(static_cast<std::uint64_t>(terms_.GetSize()));
+    for (TermId term = 0; term < terms_.GetSize(); ++term) {
+        writer.WriteString(terms_.GetWord(term));
+    }
+
+    std::vector<int> snapshot_ordinals(ordinal_to_document_id_.size(), -1);
+    std::vector<std::int32_t> document_ids;
+    std::vector<std::int32_t> ratings;
+    std::vector<std::int32_t> statuses;
+    std::vector<std::uint64_t> term_offsets = {0};
+    std::vector<TermId> document_terms;
+    std::vector<double> document_term_freqs;
+    for (size_t ordinal = 0; ordinal < ordinal_to_document_id_.size(); ++ordinal) {
+        const auto it = documents_.find(ordinal_to_document_id_[ordinal]);
+        if (it == documents_.end() || it->second.ordinal != static_cast<int>(ordinal)) {
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            std::vector<std::string_view> matched_words = {};
-            return {matched_words, documents_.at(document_id).status};
+        const DocumentData& document_data = it->second;
+        snapshot_ordinals[ordinal] = static_cast<int>(document_ids.size());
+        document_ids.push_back(it->first);
+        ratings.push_back(document_data.rating);
+        statuses.push_back(static_cast<std::int32_t>(document_data.status));
+        document_terms.insert(document_terms.end(), document_data.terms, document_data.terms + document_data.term_count);
+        document_term_freqs.insert(document_term_freqs.end(), document_data.term_freqs, document_data.term_freqs + document_data.term_count);
+        term_offsets.push_back(document_terms.size());
+    }
+    writer.Write(static_cast<std::uint64_t>(document_ids.size()));
+    writer.WriteArray(document_ids.data(), document_ids.size());
+    writer.WriteArray(ratings.data(), ratings.size());
+    writer.WriteArray(statuses.data(), statuses.size());
+    writer.WriteArray(term_offsets.data(), term_offsets.size());
+    writer.WriteArray(document_terms.data(), document_terms.size());
+    writer.WriteArray(document_term_freqs.data(), document_term_freqs.size());
+
+    // Lists of a key come in ordinal order from the segments and the buffer, and renumbering keeps it
+    const auto segments = segments_->GetSegments();
+    const OrdinalRange all_ordinals = {0, static_cast<int>(ordinal_to_document_id_.size())};
+    std::vector<std::int32_t> posting_ordinals;
+    std::vector<double> posting_term_freqs;
+    for (TermId key = 0; key < terms_.GetSize() * GetPartitionCount(); ++key) {
+        posting_ordinals.clear();
+        posting_term_freqs.clear();
+        ForEachKeyPostings(segments, key, all_ordinals, [&](const PostingList& postings) {
+            postings.ForEach([&](int ordinal, double term_freq) {
+                if (snapshot_ordinals[ordinal] >= 0) {
+                    posting_ordinals.push_back(snapshot_ordinals[ordinal]);
+                    posting_term_freqs.push_back(term_freq);
+                }
+            });
+        });
+        writer.Write(static_cast<std::uint64_t>(posting_ordinals.size()));
+        writer.WriteArray(posting_ordinals.data(), posting_ordinals.size());
+        writer.WriteArray(posting_term_freqs.data(), posting_term_freqs.size());
+    }
+    writer.Finish();
+}
+
+SearchServer SearchServer::LoadSnapshot(const std::string& path) {
+    auto snapshot = std::make_shared<SnapshotReader>(path);
+    SnapshotReader& reader = *snapshot;
+    const char* const magic = reader.ReadArray<char>(sizeof(SNAPSHOT_MAGIC));
+    if (!std::equal(magic, magic + sizeof(SNAPSHOT_MAGIC), SNAPSHOT_MAGIC)) {
+        throw std::invalid_argument("Unsupported snapshot format"s);
+    }
+    const auto version = reader.Read<std::uint32_t>();
+    if (version == 0 || version > SNAPSHOT_VERSION) {
+        throw std::invalid_argument("Unsupported snapshot format"s);
+    }
+    const auto posting_storage = static_cast<PostingStorage>(reader.Read<std::uint32_t>());
+    if (posting_storage != PostingStorage::PLAIN && posting_storage != PostingStorage::COMPRESSED) {
+        throw std::invalid_argument("Unsupported snapshot format"s);
+    }
+    const auto posting_partitioning = version < 2 ? PostingPartitioning::NONE : static_cast<PostingPartitioning>(reader.Read<std::uint32_t>());
+    // Without partitioning a list per term is a list per key, older versions differ only with BY_STATUS
+    if ((posting_partitioning != PostingPartitioning::NONE && posting_partitioning != PostingPartitioning::BY_STATUS)
+        || (version < 3 && posting_partitioning != PostingPartitioning::NONE)) {
+        throw std::invalid_argument("Unsupported snapshot format"s);
+    }
+
+    // Counts are not trusted for allocations: a corrupt one runs into the end of the file instead
+    const auto stop_word_count = reader.Read<std::uint64_t>();
+    std::vector<std::string_view> stop_words;
+    for (std::uint64_t i = 0; i < stop_word_count; ++i) {
+        stop_words.push_back(reader.ReadString());
+    }
+    SearchServer server(stop_words, posting_storage, posting_partitioning);
+
+    const auto term_count = reader.Read<std::uint64_t>();
+    for (std::uint64_t i = 0; i < term_count; ++i) {
+        if (server.terms_.InternStable(reader.ReadString()) != i) {
+            throw std::invalid_argument("Duplicate word in snapshot"s);
         }
     }
-    std::vector<std::string_view> matched_words;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+
+    const auto document_count = reader.Read<std::uint64_t>();
+    // Ordinals are ints; this also keeps document_count + 1 below from wrapping
+    if (document_count > static_cast<std::uint64_t>(std::numeric_limits<int>::max())) {
+        throw std::invalid_argument("Invalid document count in snapshot"s);
+    }
+    const std::int32_t* const document_ids = reader.ReadArray<std::int32_t>(document_count);
+    const std::int32_t* const ratings = reader.ReadArray<std::int32_t>(document_count);
+    const std::int32_t* const statuses = reader.ReadArray<std::int32_t>(document_count);
+    const std::uint64_t* const term_offsets = reader.ReadArray<std::uint64_t>(document_count + 1);
+    const TermId* const document_terms = reader.ReadArray<TermId>(term_offsets[document_count]);
+    const double* const document_term_freqs = reader.ReadArray<double>(term_offsets[document_count]);
+    server.ordinal_to_document_id_.assign(document_ids, document_ids + document_count);
+    // Number of documents of every term by the forward index, the posting lists must agree
+    std::vector<std::uint64_t> forward_document_freqs(term_count, 0);
+    for (std::uint64_t i = 0; i < document_count; ++i) {
+        if (document_ids[i] < 0 || !server.document_ids_.insert(document_ids[i]).second
+            || statuses[i] < static_cast<std::int32_t>(DocumentStatus::ACTUAL) || statuses[i] > static_cast<std::int32_t>(DocumentStatus::REMOVED)
+            || term_offsets[i] > term_offsets[i + 1] || term_offsets[i + 1] > term_offsets[document_count]) {
+            throw std::invalid_argument("Invalid document in snapshot"s);
+        }
+        DocumentData& document_data = server.documents_.emplace(document_ids[i], DocumentData{ratings[i], static_cast<DocumentStatus>(statuses[i]), static_cast<int>(i)}).first->second;
+        server.ordinal_statuses_.push_back(document_data.status);
+        server.ordinal_ratings_.push_back(document_data.rating);
+        document_data.terms = document_terms + term_offsets[i];
+        document_data.term_freqs = document_term_freqs + term_offsets[i];
+        document_data.term_count = term_offsets[i + 1] - term_offsets[i];
+        for (std::uint64_t j = term_offsets[i]; j < term_offsets[i + 1]; ++j) {
+            // Terms of a document are unique and sorted, RemoveDocument(par) relies on it
+            if (document_terms[j] >= term_count || (j > term_offsets[i] && document_terms[j] <= document_terms[j - 1])) {
+                throw std::invalid_argument("Invalid document in snapshot"s);
+            }
+            ++forward_document_freqs[document_terms[j]];
+        }
+    }
+
+    // The postings become a single segment of views into the file
+    const TermId partition_count = server.GetPartitionCount();
+    std::vector<TermId> keys;
+    std::vector<PostingList> postings;
+    std::vector<std::uint64_t> document_freqs(term_count, 0);
+    for (TermId key = 0; key < term_count * partition_count; ++key) {
+        const auto posting_count = reader.Read<std::uint64_t>();
+        const std::int32_t* const ordinals = reader.ReadArray<std::int32_t>(posting_count);
+        const double* const term_freqs = reader.ReadArray<double>(posting_count);
+        double max_term_freq = 0.0;
+        for (std::uint64_t i = 0; i < posting_count; ++i) {
+            if (ordinals[i] < (i == 0 ? 0 : ordinals[i - 1] + 1) || static_cast<std::uint64_t>(ordinals[i]) >= document_count
+                || (partition_count > 1 && static_cast<TermId>(statuses[ordinals[i]]) != key % partition_count)) {
+                throw std::invalid_argument("Invalid posting list in snapshot"s);
+            }
+            max_term_freq = std::max(max_term_freq, term_freqs[i]);
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+        document_freqs[key / partition_count] += posting_count;
+        if (posting_count > 0) {
+            keys.push_back(key);
+            postings.push_back(PostingList::MakeView(ordinals, term_freqs, posting_count, max_term_freq));
         }
     }
+    if (!reader.IsAtEnd()) {
+        throw std::invalid_argument("Unexpected data at the end of snapshot"s);
+    }
+    if (document_freqs != forward_document_freqs) {
+        throw std::invalid_argument("Invalid posting list in snapshot"s);
+    }
 
-    return {matched_words, documents_.at(document_id).status};
+    server.word_to_document_freqs_.resize(term_count * partition_count, PostingList(posting_storage));
+    server.document_freqs_.assign(document_freqs.begin(), document_freqs.end());
+    server.log_document_freqs_.resize(term_count);
+    for (TermId term = 0; term < term_count; ++term) {
+        server.UpdateLogDocumentFreq(term);
+    }
+    if (document_count > 0) {
+        server.segments_->AddSegment(IndexSegment(0, static_cast<int>(document_count), document_count,
+                                                  std::move(keys), std::move(postings), snapshot));
+    }
+    server.buffer_first_ordinal_ = static_cast<int>(document_count);
+    server.snapshot_ = std::move(snapshot);
+    server.UpdateLogDocumentCount();
+    return server;
+}
+
+SearchServer::MatchDocuments SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    const auto [matched_words, status] = MatchDocument(QueryContext::GetForCurrentThread(), raw_query, document_id);
+    return {matched_words, status};
+}
+
+SearchServer::MatchDocumentsView SearchServer::MatchDocument(QueryContext& context, const std::string_view raw_query, int document_id) const {
+    if (document_ids_.count(document_id) == 0) {
+        throw std::out_of_range("Invalid document_id"s);
+    }
+    const auto& document_data = documents_.at(document_id);
+    ParseQuery(raw_query, context.words_, context.query_);
+    segments_->GetSegments(context.segments_);
+    const auto contains_document = [&](const TermId term) {
+        const PostingList* postings = FindPostings(context.segments_, term, document_data.ordinal);
+        return postings != nullptr && postings->Contains(document_data.ordinal);
+    };
+    context.matched_words_.clear();
+    if (std::none_of(context.query_.minus_words.begin(), context.query_.minus_words.end(), contains_document)) {
+        for (const TermId term : context.query_.plus_words) {
+            if (contains_document(term)) {
+                context.matched_words_.push_back(terms_.GetWord(term));
+            }
+        }
+        std::sort(context.matched_words_.begin(), context.matched_words_.end());
+    }
+    context.segments_.clear();
+    return {context.matched_words_, document_data.status};
 }
 
 SearchServer::MatchDocuments SearchServer::MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const {
@@ -115,52 +675,56 @@ SearchServer::MatchDocuments SearchServer::MatchDocument(const std::execution::p
     if (document_ids_.count(document_id) == 0) {
         throw std::out_of_range("Invalid document_id"s);
     }
-    const auto query = ParseQuery(raw_query, false);
+    const auto& document_data = documents_.at(document_id);
+    const auto query = ParseQuery(raw_query);
+    const auto segments = segments_->GetSegments();
+    const auto contains_document = [&](const TermId term) {
+        const PostingList* postings = FindPostings(segments, term, document_data.ordinal);
+        return postings != nullptr && postings->Contains(document_data.ordinal);
+    };
 
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-                    [&](const auto& minus_word) {
-                        if (word_to_document_freqs_.count(minus_word)) {
-                            return word_to_document_freqs_.at(minus_word).count(document_id) != 0;
-                        } else return false;
-                    })) {
+    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), contains_document)) {
         std::vector<std::string_view> matched_words = {};
-        return {matched_words, documents_.at(document_id).status};
-    }
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-    std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(),
-                 [&] (const auto& plus_word) {
-                     if (word_to_document_freqs_.count(plus_word)) {
-                         return word_to_document_freqs_.at(plus_word).count(document_id) != 0;
-                     } else return false;
-                 });
-    matched_words.erase(std::remove(matched_words.begin(), matched_words.end(), ""), matched_words.end());
+        return {matched_words, document_data.status};
+    }
+    std::vector<TermId> matched_terms(query.plus_words.size());
+    const auto matched_end = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_terms.begin(),
+                                          contains_document);
+    std::vector<std::string_view> matched_words;
+    matched_words.reserve(matched_end - matched_terms.begin());
+    std::transform(matched_terms.begin(), matched_end, std::back_inserter(matched_words),
+                   [&] (const TermId term) {return terms_.GetWord(term);});
     std::sort(matched_words.begin(), matched_words.end());
-    matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
 
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, document_data.status};
 }
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(const std::string_view word) {
-    return std::none_of(word.begin(), word.end(), [](char c) {
-        return c >= '\0' && c < ' ';
-    });
+    return !HasControlCharacters(word);
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
-    std::vector<std::string_view> words;
-    for (const std::string_view word : SplitIntoWords(text)) {
+std::vector<std::string_view>& SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
+    static thread_local std::vector<std::string_view> words;
+    if (!SplitIntoWords(text, words)) {
+        ThrowInvalidWord(words, "Word "s);
+    }
+    words.erase(std::remove_if(words.begin(), words.end(), [this](const std::string_view word) {
+        return IsStopWord(word);
+    }), words.end());
+    return words;
+}
+
+void SearchServer::ThrowInvalidWord(const std::vector<std::string_view>& words, const std::string& prefix) {
+    for (const std::string_view word : words) {
         if (!IsValidWord(word)) {
-            throw std::invalid_argument("Word "s + std::string(word) + " is invalid"s);
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+            throw std::invalid_argument(prefix + std::string(word) + " is invalid"s);
         }
     }
-    return words;
+    throw std::invalid_argument(prefix + "is invalid"s);
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -181,37 +745,311 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text
         is_minus = true;
         result = result.substr(1);
     }
-    if (result.empty() || result[0] == '-' || !IsValidWord(result)) {
+    if (result.empty() || result[0] == '-') {
         throw std::invalid_argument("Query word "s + std::string(result) + " is invalid");
     }
 
     return {result, is_minus, IsStopWord(text)};
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text, const bool is_seq_pol) const {
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const {
+    static thread_local std::vector<std::string_view> words;
     Query result;
-    for (const std::string_view& word : SplitIntoWords(text)) {
+    ParseQuery(text, words, result);
+    return result;
+}
+
+void SearchServer::ParseQuery(const std::string_view text, std::vector<std::string_view>& words, Query& result) const {
+    if (!SplitIntoWords(text, words)) {
+        ThrowInvalidWord(words, "Query word "s);
+    }
+    result.plus_words.clear();
+    result.minus_words.clear();
+    for (const std::string_view& word : words) {
         const auto query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
+            // Words missing from the dictionary match no document and are dropped right away
+            const TermId term = terms_.Find(query_word.data);
+            if (term == TermDictionary::NO_TERM) {
+                continue;
+            }
             if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
+                result.minus_words.push_back(term);
             } else {
-                result.plus_words.push_back(query_word.data);
+                result.plus_words.push_back(term);
             }
         }
     }
-    if (is_seq_pol == false) {
-        std::sort(std::execution::par, result.plus_words.begin(), result.plus_words.end());
-        std::sort(std::execution::par, result.minus_words.begin(), result.minus_words.end());
-    } else {
-        std::sort(result.plus_words.begin(), result.plus_words.end());
-        std::sort(result.minus_words.begin(), result.minus_words.end());
-    }
+    // Queries have a handful of words: a plain sort, whatever the execution policy of the caller
+    std::sort(result.plus_words.begin(), result.plus_words.end());
+    std::sort(result.minus_words.begin(), result.minus_words.end());
     result.plus_words.erase(std::unique(result.plus_words.begin(), result.plus_words.end()), result.plus_words.end());
     result.minus_words.erase(std::unique(result.minus_words.begin(), result.minus_words.end()), result.minus_words.end());
-    return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / static_cast<double>(word_to_document_freqs_.at(word).size()));
+void SearchServer::FindTopDocumentsCached(QueryContext& context, DocumentStatus status, size_t max_result_count,
+                                          const QueryCancellation* cancellation) const {
+    if (!result_cache_) {
+        FindTopDocumentsWithPruning(context, status, max_result_count, cancellation);
+        return;
+    }
+    ResultCache::Key& key = context.cache_key_;
+    key.plus_words.assign(context.query_.plus_words.begin(), context.query_.plus_words.end());
+    key.minus_words.assign(context.query_.minus_words.begin(), context.query_.minus_words.end());
+    key.status = status;
+    key.max_result_count = max_result_count;
+    if (result_cache_->Find(key, generation_, context.documents_)) {
+        return;
+    }
+    FindTopDocumentsWithPruning(context, status, max_result_count, cancellation);
+    result_cache_->Insert(key, generation_, context.documents_);
+}
+
+// MaxScore evaluation: query terms are ordered by their score upper bound (IDF * max TF). Once the top is
+// full, the terms whose bounds add up to no more than the threshold become non-essential: a document
+// found only in them cannot enter the top, so candidates come from the essential terms alone and
+// the non-essential lists are only probed while the document can still beat the threshold.
+// Segments hold disjoint documents and are evaluated one after another with a shared top.
+void SearchServer::FindTopDocumentsWithPruning(QueryContext& context, DocumentStatus status, size_t max_result_count,
+                                               const QueryCancellation* cancellation) const {
+    // Also checked every CANCELLATION_CHECK_INTERVAL postings: one segment may hold most of the index
+    size_t posting_count = 0;
+    const auto throw_if_cancelled = [cancellation, &posting_count]() {
+        if (cancellation != nullptr) {
+            posting_count = 0;
+            cancellation->ThrowIfCancelled();
+        }
+    };
+    const Query& query = context.query_;
+    auto& segments = context.segments_;
+    segments_->GetSegments(segments);
+    const OrdinalRange all_ordinals = {0, static_cast<int>(ordinal_to_document_id_.size())};
+    auto& excluded = ScoreAccumulator::GetForCurrentThread();
+    excluded.Prepare(all_ordinals.last);
+    for (const TermId term : query.minus_words) {
+        ForEachPostings(segments, term, status, all_ordinals, [&](const PostingList& postings) {
+            throw_if_cancelled();
+            postings.ForEach([&](int ordinal, double) {
+                if (++posting_count == CANCELLATION_CHECK_INTERVAL) {
+                    throw_if_cancelled();
+                }
+                excluded.Exclude(ordinal);
+            });
+        });
+    }
+
+    TopDocuments& top_documents = context.top_documents_;
+    top_documents.Reset(max_result_count);
+    // A document can only enter a full top if its relevance exceeds this: within DELTA of
+    // the worst kept document it may still win on rating
+    double threshold = -std::numeric_limits<double>::infinity();
+    if (max_result_count > 0) {
+        auto& postings = context.postings_;
+        postings.resize(query.plus_words.size());
+        for (const auto& segment : segments) {
+            for (size_t i = 0; i < query.plus_words.size(); ++i) {
+                postings[i] = segment->FindPostings(GetPostingKey(query.plus_words[i], status));
+            }
+            throw_if_cancelled();
+            ScoreWithPruning(context, status, excluded, threshold, cancellation);
+        }
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            const TermId key = GetPostingKey(query.plus_words[i], status);
+            postings[i] = key < word_to_document_freqs_.size() ? &word_to_document_freqs_[key] : nullptr;
+        }
+        throw_if_cancelled();
+        ScoreWithPruning(context, status, excluded, threshold, cancellation);
+    }
+    segments.clear();
+    top_documents.Extract(context.documents_);
+}
+
+void SearchServer::ScoreWithPruning(QueryContext& context, DocumentStatus status, const ScoreAccumulator& excluded, double& threshold,
+                                    const QueryCancellation* cancellation) const {
+    const Query& query = context.query_;
+    const auto& postings = context.postings_;
+    TopDocuments& top_documents = context.top_documents_;
+    // Bounds are compared against partial sums taken in another order, so they get a rounding margin
+    constexpr double SCORE_BOUND_MARGIN = 1e-9;
+
+    auto& cursors = context.cursors_;
+    cursors.clear();
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (postings[i] == nullptr || postings[i]->IsEmpty() || document_freqs_[query.plus_words[i]] == 0) {
+            continue;
+        }
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(query.plus_words[i]);
+        cursors.push_back({i, inverse_document_freq, inverse_document_freq * postings[i]->GetMaxTermFreq(), PostingList::Cursor(*postings[i])});
+    }
+    std::sort(cursors.begin(), cursors.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+        return lhs.max_score < rhs.max_score;
+    });
+    auto& max_score_prefix = context.max_score_prefix_;
+    max_score_prefix.resize(cursors.size());
+    double max_score_sum = 0.0;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        max_score_sum += cursors[i].max_score;
+        max_score_prefix[i] = max_score_sum + SCORE_BOUND_MARGIN;
+    }
+
+    size_t first_essential = 0;
+    while (first_essential < cursors.size() && max_score_prefix[first_essential] <= threshold) {
+        ++first_essential;
+    }
+    // Contributions are summed in query term order, exactly like the exhaustive path
+    auto& term_scores = context.term_scores_;
+    term_scores.assign(query.plus_words.size(), 0.0);
+
+    size_t candidate_count = 0;
+    while (first_essential < cursors.size()) {
+        if (cancellation != nullptr && ++candidate_count == CANCELLATION_CHECK_INTERVAL) {
+            candidate_count = 0;
+            cancellation->ThrowIfCancelled();
+        }
+        int ordinal = std::numeric_limits<int>::max();
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            if (!cursors[i].cursor.IsAtEnd()) {
+                ordinal = std::min(ordinal, cursors[i].cursor.GetDocumentId());
+            }
+        }
+        if (ordinal == std::numeric_limits<int>::max()) {
+            break;
+        }
+
+        double score = 0.0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            auto& cursor = cursors[i].cursor;
+            if (!cursor.IsAtEnd() && cursor.GetDocumentId() == ordinal) {
+                const double term_score = cursor.GetTermFreq() * cursors[i].inverse_document_freq;
+                term_scores[cursors[i].query_position] = term_score;
+                score += term_score;
+                cursor.Next();
+            }
+        }
+
+        bool is_candidate = !excluded.IsExcluded(ordinal) && !segments_->IsRemoved(ordinal)
+                            && (first_essential == 0 || score + max_score_prefix[first_essential - 1] > threshold);
+        is_candidate = is_candidate && ordinal_statuses_[ordinal] == status;
+        for (size_t i = first_essential; is_candidate && i-- > 0;) {
+            if (score + max_score_prefix[i] <= threshold) {
+                is_candidate = false;
+                break;
+            }
+            auto& cursor = cursors[i].cursor;
+            cursor.SkipTo(ordinal);
+            if (!cursor.IsAtEnd() && cursor.GetDocumentId() == ordinal) {
+                const double term_score = cursor.GetTermFreq() * cursors[i].inverse_document_freq;
+                term_scores[cursors[i].query_position] = term_score;
+                score += term_score;
+            }
+        }
+
+        if (is_candidate) {
+            double relevance = 0.0;
+            for (const double term_score : term_scores) {
+                relevance += term_score;
+            }
+            top_documents.Add({ordinal_to_document_id_[ordinal], relevance, ordinal_ratings_[ordinal]});
+            if (top_documents.IsFull()) {
+                threshold = std::max(threshold, top_documents.GetWorst().relevance - DELTA);
+                while (first_essential < cursors.size() && max_score_prefix[first_essential] <= threshold) {
+                    ++first_essential;
+                }
+            }
+        }
+        std::fill(term_scores.begin(), term_scores.end(), 0.0);
+    }
+}
+
+std::vector<SearchServer::OrdinalRange> SearchServer::SplitIntoOrdinalRanges() const {
+    const int ordinal_count = static_cast<int>(ordinal_to_document_id_.size());
+    const int max_range_count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) * 4;
+    const int range_count = std::clamp(ordinal_count / MIN_ORDINAL_RANGE_SIZE, 1, max_range_count);
+    std::vector<OrdinalRange> ranges;
+    ranges.reserve(range_count);
+    for (int i = 0; i < range_count; ++i) {
+        ranges.push_back({static_cast<int>(static_cast<long long>(ordinal_count) * i / range_count),
+                          static_cast<int>(static_cast<long long>(ordinal_count) * (i + 1) / range_count)});
+    }
+    return ranges;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term) const {
+    return log_document_count_ - log_document_freqs_[term];
+}
+
+void SearchServer::UpdateLogDocumentFreq(TermId term) {
+    log_document_freqs_[term] = log(static_cast<double>(document_freqs_[term]));
+}
+
+void SearchServer::SealWriteBuffer() {
+    const int last_ordinal = static_cast<int>(ordinal_to_document_id_.size());
+    std::vector<TermId> terms;
+    std::vector<PostingList> postings;
+    for (TermId key = 0; key < word_to_document_freqs_.size(); ++key) {
+        PostingList& buffer_postings = word_to_document_freqs_[key];
+        DropRemovedPostings(buffer_postings);
+        if (!buffer_postings.IsEmpty()) {
+            terms.push_back(key);
+            postings.push_back(std::move(buffer_postings));
+        }
+        buffer_postings = PostingList(posting_storage_);
+    }
+    size_t document_count = 0;
+    for (int ordinal = buffer_first_ordinal_; ordinal < last_ordinal; ++ordinal) {
+        document_count += segments_->IsRemoved(ordinal) ? 0 : 1;
+    }
+    segments_->AddSegment(IndexSegment(buffer_first_ordinal_, last_ordinal, document_count, std::move(terms), std::move(postings)));
+    buffer_first_ordinal_ = last_ordinal;
+}
+
+void SearchServer::DropRemovedPostings(PostingList& postings) const {
+    bool has_removed = false;
+    postings.ForEach([&](int ordinal, double) {
+        has_removed = has_removed || segments_->IsRemoved(ordinal);
+    });
+    if (!has_removed) {
+        return;
+    }
+    std::vector<int> document_ids;
+    std::vector<double> term_freqs;
+    postings.ForEach([&](int ordinal, double term_freq) {
+        if (!segments_->IsRemoved(ordinal)) {
+            document_ids.push_back(ordinal);
+            term_freqs.push_back(term_freq);
+        }
+    });
+    postings = PostingList(posting_storage_);
+    postings.Append(document_ids.data(), term_freqs.data(), document_ids.size());
+}
+
+void SearchServer::SealWriteBufferIfFull() {
+    if (static_cast<int>(ordinal_to_document_id_.size()) - buffer_first_ordinal_ >= SEGMENT_ORDINAL_COUNT) {
+        SealWriteBuffer();
+    }
+}
+
+TermId SearchServer::GetPartitionCount() const {
+    return posting_partitioning_ == PostingPartitioning::BY_STATUS ? STATUS_PARTITION_COUNT : 1;
+}
+
+TermId SearchServer::GetPostingKey(TermId term, DocumentStatus status) const {
+    return posting_partitioning_ == PostingPartitioning::BY_STATUS ? term * STATUS_PARTITION_COUNT + static_cast<TermId>(status) : term;
+}
+
+const PostingList* SearchServer::FindPostings(const SegmentSet::Segments& segments, TermId term, int ordinal) const {
+    // An ordinal keeps its status with partitioning, a status change moves the document to a new one
+    const TermId key = GetPostingKey(term, ordinal_statuses_[ordinal]);
+    if (ordinal >= buffer_first_ordinal_) {
+        return key < word_to_document_freqs_.size() ? &word_to_document_freqs_[key] : nullptr;
+    }
+    const auto segment = std::upper_bound(segments.begin(), segments.end(), ordinal, [](int ordinal, const auto& segment) {
+        return ordinal < segment->GetLastOrdinal();
+    });
+    return segment == segments.end() ? nullptr : (*segment)->FindPostings(key);
+}
+
+void SearchServer::UpdateLogDocumentCount() {
+    log_document_count_ = log(static_cast<double>(GetDocumentCount()));
+    ++generation_;
 }
@@ -3,52 +3,127 @@
 #include <string_view>
 #include <vector>
 #include <map>
+#include <limits>
 #include <algorithm>
 #include <utility>
 #include <numeric>
 #include <cmath>
 #include <execution>
-#include <deque>
 #include <execution>
+#include <exception>
+#include <memory>
 #include <mutex>
+#include <thread>
 
 #include "document.h"
+#include "document_filters.h"
 #include "string_processing.h"
 #include "log_duration.h"
-#include "concurrent_map.h"
+#include "term_dictionary.h"
+#include "posting_list.h"
+#include "segment_set.h"
+#include "score_accumulator.h"
+#include "top_documents.h"
+#include "query_cancellation.h"
+#include "result_cache.h"
+#include "stop_word_set.h"
 
 using namespace std::string_literals;
 
+class SnapshotReader;
+
+// BY_STATUS keeps a separate posting list per term and document status, so that a query for one
+// status never reads the postings of documents with another one
+enum class PostingPartitioning {
+    NONE,
+    BY_STATUS,
+};
+
 class SearchServer {
 public:
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
-    explicit SearchServer(const std::string_view stop_words_text)
+    explicit SearchServer(const StringContainer& stop_words, PostingStorage posting_storage = PostingStorage::PLAIN,
+                          PostingPartitioning posting_partitioning = PostingPartitioning::NONE);
+    explicit SearchServer(const std::string_view stop_words_text, PostingStorage posting_storage = PostingStorage::PLAIN,
+                          PostingPartitioning posting_partitioning = PostingPartitioning::NONE)
             : SearchServer(
-            SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
+            SplitIntoWords(stop_words_text), posting_storage, posting_partitioning)  // Invoke delegating constructor from string container
     {
     }
-    explicit SearchServer(const std::string& stop_words_text)
-            : SearchServer(std::string_view (stop_words_text))  // Invoke delegating constructor from string container
+    explicit SearchServer(const std::string& stop_words_text, PostingStorage posting_storage = PostingStorage::PLAIN,
+                          PostingPartitioning posting_partitioning = PostingPartitioning::NONE)
+            : SearchServer(std::string_view (stop_words_text), posting_storage, posting_partitioning)  // Invoke delegating constructor from string container
     {
     }
+    // The copy shares the sealed segments and a loaded snapshot with the original and starts with
+    // an empty result cache of the same budget. The original may be read meanwhile.
+    SearchServer(const SearchServer& other);
+    SearchServer(SearchServer&&) = default;
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status,
                      const std::vector<int>& ratings);
 
+    struct NewDocument {
+        int id;
+        std::string_view text;
+        DocumentStatus status;
+        std::vector<int> ratings;
+    };
+    // Adds a batch of documents: either all of them are added or, on invalid input, none
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void AddDocuments(std::execution::sequenced_policy, const std::vector<NewDocument>& documents);
+    void AddDocuments(std::execution::parallel_policy, const std::vector<NewDocument>& documents);
+
+    // max_result_count limits how many of the best documents are selected and returned,
+    // e.g. (page + 1) * page_size for a paginated caller
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+                                           size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
 
+    // Scratch space of queries, see its definition below
+    class QueryContext;
+    // FindTopDocuments(raw_query, status, max_result_count) parsed and scored in the buffers of the
+    // context, which allocates nothing once they have grown. The result is kept in the context
+    // and stays valid until its next query
+    const std::vector<Document>& FindTopDocuments(QueryContext& context, const std::string_view raw_query,
+                                                  DocumentStatus status = DocumentStatus::ACTUAL,
+                                                  size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    // Stops with QueryCancelledError once the cancellation fires; it is checked between posting lists
+    // and every 1024 postings or candidate documents within them
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status, size_t max_result_count,
+                                           const QueryCancellation& cancellation) const;
+
     template <typename DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status,
+                                           size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query) const;
 
-
+    // FindTopDocuments(raw_query, status, max_result_count) for every query of a batch, without
+    // pruning or the result cache. The posting list of every term is decoded once and shared by
+    // the queries using it; neighbouring queries are decoded in groups within a posting budget.
+    // Faster than separate queries when pruning skips little, e.g. for words of similar frequency
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries,
+                                                             DocumentStatus status = DocumentStatus::ACTUAL,
+                                                             size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    // Same for the queries in [first, last), e.g. a window of a larger vector
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(std::vector<std::string>::const_iterator first,
+                                                             std::vector<std::string>::const_iterator last,
+                                                             DocumentStatus status = DocumentStatus::ACTUAL,
+                                                             size_t max_result_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Opt-in cache of FindTopDocuments(raw_query[, status[, max_result_count]]) results, keyed by the
+    // parsed query. Adding or removing documents invalidates every cached result. memory_budget is
+    // the approximate size in bytes the cache may take
+    void EnableResultCache(size_t memory_budget);
+    // All zeros if the cache is not enabled
+    ResultCache::Stats GetResultCacheStats() const;
 
     int GetDocumentCount() const;
 
@@ -60,58 +135,226 @@ public:
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::sequenced_policy, int document_id);
     void RemoveDocument(std::execution::parallel_policy, int document_id);
+    // Removes many documents with one pass over the tombstones and the term counters.
+    // Unknown ids are skipped.
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    // Removal and status changes with BY_STATUS only set a tombstone, so ordinals are used up.
+    // This drops the postings of removed documents and renumbers the ordinals densely, like
+    // SaveSnapshot does: segments after the first removed ordinal are rebuilt in parallel and
+    // the per-ordinal tables shrink. The index is changed like by AddDocument.
+    void CompactIndex();
+
+    // Without partitioning only the status is changed. With BY_STATUS the postings of the document
+    // move to the lists of the new status: the document gets a new ordinal in the write buffer,
+    // built from its stored term frequencies, and the old one is removed.
+    void SetDocumentStatus(int document_id, DocumentStatus status);
+
+    // Versioned binary snapshot of the whole index. Loading maps the file and serves the postings
+    // and the forward index from the mapped pages: the file is read once to validate it, and only
+    // per-document metadata and the dictionary lookup table are built in memory. A loaded file
+    // must not be changed in place; SaveSnapshot writes a new file and renames it over the path.
+    void SaveSnapshot(const std::string& path) const;
+    static SearchServer LoadSnapshot(const std::string& path);
 
     using MatchDocuments = std::tuple<std::vector<std::string_view>, DocumentStatus>;
     MatchDocuments MatchDocument(const std::string_view raw_query, int document_id) const;
     MatchDocuments MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const;
     MatchDocuments MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query, int document_id) const;
+    // Matched words are kept in the context until its next query
+    using MatchDocumentsView = std::tuple<const std::vector<std::string_view>&, DocumentStatus>;
+    MatchDocumentsView MatchDocument(QueryContext& context, const std::string_view raw_query, int document_id) const;
 
 private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
-        std::deque<std::string> string_storage;
+        int ordinal;
+        // Sorted term ids of the document and their frequencies: in terms_storage and
+        // term_freqs_storage, or in the mapped file for a document loaded from a snapshot
+        const TermId* terms = nullptr;
+        const double* term_freqs = nullptr;
+        size_t term_count = 0;
+        std::vector<TermId> terms_storage = {};
+        std::vector<double> term_freqs_storage = {};
+
+        // Points the terms at the storage vectors once they are filled
+        void UseStorage() {
+            terms = terms_storage.data();
+            term_freqs = term_freqs_storage.data();
+            term_count = terms_storage.size();
+        }
     };
-    const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> word_freqs_;
+    const StopWordSet stop_words_;
+    const PostingStorage posting_storage_;
+    const PostingPartitioning posting_partitioning_;
+    TermDictionary terms_;
+    // Postings refer to documents by ordinal: a dense number given out in insertion order and
+    // renumbered by CompactIndex.
+    // New documents go to the write buffer, which is sealed into an immutable segment once it
+    // spans SEGMENT_ORDINAL_COUNT ordinals. Queries read the sealed segments and the buffer.
+    // Lists are addressed by posting key, see GetPostingKey
+    std::vector<PostingList> word_to_document_freqs_;
+    int buffer_first_ordinal_ = 0;
+    std::unique_ptr<SegmentSet> segments_;
+    // Number of live documents per term
+    std::vector<int> document_freqs_;
+    // IDF is kept as log(document count) - log(document freq): adding or removing a document
+    // refreshes only the logarithms of its own terms and of the document count
+    std::vector<double> log_document_freqs_;
+    double log_document_count_ = 0.0;
+    // Maps of GetWordFrequencies, built on the first request for a document. The mutex is
+    // held by pointer to keep the server movable
+    mutable std::map<int, std::map<std::string_view, double>> word_freqs_;
+    std::unique_ptr<std::mutex> word_freqs_mutex_ = std::make_unique<std::mutex>();
     std::map<int, DocumentData> documents_;
     std::set<int> document_ids_;
+    std::vector<int> ordinal_to_document_id_;
+    // Status and rating per ordinal, read by the query paths instead of documents_
+    std::vector<DocumentStatus> ordinal_statuses_;
+    std::vector<int> ordinal_ratings_;
+    std::unique_ptr<ResultCache> result_cache_;
+    // Mapped file of a loaded snapshot, which the first segment and the forward index read
+    std::shared_ptr<const SnapshotReader> snapshot_;
+    // Changes whenever the set of documents does; cached results of other generations are stale
+    uint64_t generation_ = 0;
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
     };
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<TermId> plus_words;
+        std::vector<TermId> minus_words;
     };
+    // Posting list cursor of a query term in a MaxScore pass
+    struct TermCursor {
+        size_t query_position;
+        double inverse_document_freq;
+        double max_score;
+        PostingList::Cursor cursor;
+    };
+    // Half-open range of document ordinals scored by one worker of a parallel query
+    struct OrdinalRange {
+        int first;
+        int last;
+    };
+    static constexpr int MIN_ORDINAL_RANGE_SIZE = 1 << 14;
+    static constexpr int SEGMENT_ORDINAL_COUNT = 1 << 14;
+    static constexpr TermId STATUS_PARTITION_COUNT = 4;
+    static constexpr size_t CANCELLATION_CHECK_INTERVAL = 1024;
+    // Postings decoded at once by FindTopDocumentsBatch, 12 bytes each
+    static constexpr size_t BATCH_POSTING_BUDGET = 1 << 22;
 
     bool IsStopWord(const std::string_view word) const;
 
     static bool IsValidWord(const std::string_view word);
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    // Words of the text without stop words, in a buffer of the calling thread that the next call reuses
+    std::vector<std::string_view>& SplitIntoWordsNoStop(const std::string_view text) const;
+    // Throws invalid_argument naming the first word of the text holding a control character
+    [[noreturn]] static void ThrowInvalidWord(const std::vector<std::string_view>& words, const std::string& prefix);
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
     QueryWord ParseQueryWord(const std::string_view text) const;
 
-    Query ParseQuery(const std::string_view text, const bool is_seq_pol = true) const;
+    Query ParseQuery(const std::string_view text) const;
+    // Splits the text into words and parses them into result, both buffers are reused
+    void ParseQuery(const std::string_view text, std::vector<std::string_view>& words, Query& result) const;
+
+    double ComputeWordInverseDocumentFreq(TermId term) const;
+    template <typename ExecutionPolicy>
+    void AddDocumentBatch(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents);
+    void UpdateLogDocumentFreq(TermId term);
+    void EraseWordFrequencies(int document_id);
+    void SealWriteBuffer();
+    // Rebuilds the list without the postings of removed documents, if it has any
+    void DropRemovedPostings(PostingList& postings) const;
+    void SealWriteBufferIfFull();
+    // Posting lists are addressed by key: the term itself, or with BY_STATUS partitioning
+    // term * STATUS_PARTITION_COUNT + status, which gives every status of a term its own list
+    TermId GetPartitionCount() const;
+    TermId GetPostingKey(TermId term, DocumentStatus status) const;
+    // Calls function(postings) for the posting lists of the key in the sealed segments
+    // and the write buffer that overlap the range, in ordinal order
+    template <typename Function>
+    void ForEachKeyPostings(const SegmentSet::Segments& segments, TermId key, OrdinalRange range, Function function) const;
+    // Same for all lists of the term. Ordinals are ascending within a list, but with partitioning
+    // the lists of different statuses interleave
+    template <typename Function>
+    void ForEachPostings(const SegmentSet::Segments& segments, TermId term, OrdinalRange range, Function function) const;
+    // Lists of the term that may hold documents with the status: with partitioning only those of
+    // that status, otherwise all of them
+    template <typename Function>
+    void ForEachPostings(const SegmentSet::Segments& segments, TermId term, DocumentStatus status, OrdinalRange range, Function function) const;
+    // Posting list of the term in the segment or the buffer holding the ordinal, nullptr if there is none
+    const PostingList* FindPostings(const SegmentSet::Segments& segments, TermId term, int ordinal) const;
+    // Called after every change of the document set: refreshes log(document count) and the generation
+    void UpdateLogDocumentCount();
+
+    template <typename ExecutionPolicy>
+    static void SelectTopDocuments(const ExecutionPolicy& policy, std::vector<Document>& documents, size_t max_result_count);
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    std::vector<OrdinalRange> SplitIntoOrdinalRanges() const;
 
+    // Filters of document_filters.h read the columns directly, other predicates get the values from them
+    template <typename DocumentPredicate>
+    bool AcceptsDocument(const DocumentPredicate& document_predicate, int ordinal) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocumentsInRange(const SegmentSet::Segments& segments, const Query& query, DocumentPredicate document_predicate, OrdinalRange range) const;
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+    // The query parsed into the context and its result go through the result cache, if it is enabled
+    void FindTopDocumentsCached(QueryContext& context, DocumentStatus status, size_t max_result_count,
+                                const QueryCancellation* cancellation = nullptr) const;
+    // Scores the query parsed into the context, the result goes to context.documents_
+    void FindTopDocumentsWithPruning(QueryContext& context, DocumentStatus status, size_t max_result_count,
+                                     const QueryCancellation* cancellation) const;
+    // One MaxScore pass over the posting lists of a segment in context.postings_
+    // (one per plus word, may be nullptr)
+    void ScoreWithPruning(QueryContext& context, DocumentStatus status, const ScoreAccumulator& excluded, double& threshold,
+                          const QueryCancellation* cancellation) const;
+    // Scores queries [first_query, last_query) of a batch into results; batch_terms are their
+    // sorted distinct terms
+    void FindTopDocumentsBatchGroup(const std::vector<Query>& queries, size_t first_query, size_t last_query,
+                                    const std::vector<TermId>& batch_terms, DocumentStatus status, size_t max_result_count,
+                                    std::vector<std::vector<Document>>& results) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocumentsByRanges(const Query& query, DocumentPredicate document_predicate, size_t max_result_count) const;
+};
+
+// Buffers of one query at a time, reused by the next one: parsed words and terms, the segment
+// list, cursors and scores of the MaxScore passes, the top and the result. Every thread may
+// use its own with GetForCurrentThread; a context must not be shared by concurrent queries.
+class SearchServer::QueryContext {
+public:
+    static QueryContext& GetForCurrentThread();
+
+private:
+    friend class SearchServer;
+
+    std::vector<std::string_view> words_;
+    Query query_;
+    // Cleared at the end of every query rather than held until the next one, so that merged segments can be freed
+    SegmentSet::Segments segments_;
+    std::vector<const PostingList*> postings_;
+    std::vector<TermCursor> cursors_;
+    std::vector<double> max_score_prefix_;
+    std::vector<double> term_scores_;
+    TopDocuments top_documents_{0};
+    std::vector<Document> documents_;
+    std::vector<std::string_view> matched_words_;
+    ResultCache::Key cache_key_;
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
+SearchServer::SearchServer(const StringContainer& stop_words, PostingStorage posting_storage, PostingPartitioning posting_partitioning)
         : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
+        , posting_storage_(posting_storage)
+        , posting_partitioning_(posting_partitioning)
+        , segments_(std::make_unique<SegmentSet>(posting_storage))
 {
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw std::invalid_argument("Some of stop words are invalid"s);
@@ -119,50 +362,31 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(query, document_predicate);
-    sort(matched_documents.begin(), matched_documents.end(),
-         [](const Document &lhs, const Document &rhs) {
-             if (std::abs(lhs.relevance - rhs.relevance) < DELTA) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, size_t max_result_count) const {
+    // A status filter takes the pruned path of the status overload
+    if constexpr (std::is_same_v<DocumentPredicate, StatusIs>) {
+        return FindTopDocuments(raw_query, document_predicate.status, max_result_count);
+    } else {
+        const auto query = ParseQuery(raw_query);
+        auto matched_documents = FindAllDocuments(query, document_predicate);
+        SelectTopDocuments(std::execution::seq, matched_documents, max_result_count);
+        return matched_documents;
     }
-    return matched_documents;
 }
 
 template<typename DocumentPredicate, typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy&, const std::string_view raw_query, DocumentPredicate document_predicate, size_t max_result_count) const {
     if (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
-        return FindTopDocuments(raw_query, document_predicate);
+        return FindTopDocuments(raw_query, document_predicate, max_result_count);
     } else {
-        const auto query = ParseQuery(raw_query, false);
-        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-        sort(std::execution::par, matched_documents.begin(), matched_documents.end(),
-             [](const Document &lhs, const Document &rhs) {
-                 if (std::abs(lhs.relevance - rhs.relevance) < DELTA) {
-                     return lhs.rating > rhs.rating;
-                 } else {
-                     return lhs.relevance > rhs.relevance;
-                 }
-             });
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
-        return matched_documents;
+        const auto query = ParseQuery(raw_query);
+        return FindTopDocumentsByRanges(query, document_predicate, max_result_count);
     }
 }
 
 template<typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-    });
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status, size_t max_result_count) const {
+    return FindTopDocuments(policy, raw_query, StatusIs{status}, max_result_count);
 }
 
 template<typename ExecutionPolicy>
@@ -170,72 +394,279 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& poli
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template <typename ExecutionPolicy>
+void SearchServer::SelectTopDocuments(const ExecutionPolicy& policy, std::vector<Document>& documents, size_t max_result_count) {
+    // Only the first max_result_count places are ordered: O(N log K) instead of a full sort
+    const size_t result_count = std::min(documents.size(), max_result_count);
+    std::partial_sort(policy, documents.begin(), documents.begin() + result_count, documents.end(), IsMoreRelevant);
+    documents.resize(result_count);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::AddDocumentBatch(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents) {
+    std::set<int> batch_ids;
+    for (const NewDocument& document : documents) {
+        if ((document.id < 0) || (document_ids_.count(document.id) > 0) || !batch_ids.insert(document.id).second) {
+            throw std::invalid_argument("Invalid document_id"s);
+        }
+    }
+
+    // Tokenization and term frequencies are computed per document in parallel. Words of a document
+    // are sorted, so the frequency of each distinct word is summed exactly as AddDocument does
+    struct ParsedDocument {
+        std::vector<std::pair<std::string_view, double>> word_freqs;
+        std::exception_ptr error;
+    };
+    std::vector<ParsedDocument> parsed_documents(documents.size());
+    std::transform(policy, documents.begin(), documents.end(), parsed_documents.begin(),
+                   [this](const NewDocument& document) {
+                       ParsedDocument parsed;
+                       try {
+                           auto& words = SplitIntoWordsNoStop(document.text);
+                           std::sort(words.begin(), words.end());
+                           const double inv_word_count = 1.0 / static_cast<double>(words.size());
+                           for (const std::string_view word : words) {
+                               if (parsed.word_freqs.empty() || parsed.word_freqs.back().first != word) {
+                                   parsed.word_freqs.emplace_back(word, 0.0);
+                               }
+                               parsed.word_freqs.back().second += inv_word_count;
+                           }
+                       } catch (...) {
+                           parsed.error = std::current_exception();
+                       }
+                       return parsed;
+                   });
+    for (const ParsedDocument& parsed : parsed_documents) {
+        if (parsed.error) {
+            std::rethrow_exception(parsed.error);
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+    }
+
+    // Interning and ordinal assignment is the only sequential part of the merge
+    const int first_ordinal = static_cast<int>(ordinal_to_document_id_.size());
+    std::vector<DocumentData*> batch_data(documents.size());
+    std::vector<size_t> key_posting_counts;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const NewDocument& document = documents[i];
+        DocumentData& document_data = documents_.emplace(document.id, DocumentData{ComputeAverageRating(document.ratings), document.status, first_ordinal + static_cast<int>(i)}).first->second;
+        document_data.terms_storage.reserve(parsed_documents[i].word_freqs.size());
+        for (const auto& [word, term_freq] : parsed_documents[i].word_freqs) {
+            const TermId term = terms_.Intern(word);
+            document_data.terms_storage.push_back(term);
+            const TermId key = GetPostingKey(term, document.status);
+            if (key >= key_posting_counts.size()) {
+                key_posting_counts.resize(key + 1);
             }
+            ++key_posting_counts[key];
+        }
+        batch_data[i] = &document_data;
+        document_ids_.insert(document.id);
+        ordinal_to_document_id_.push_back(document.id);
+        ordinal_statuses_.push_back(document.status);
+        ordinal_ratings_.push_back(document_data.rating);
+    }
+    word_to_document_freqs_.resize(terms_.GetSize() * GetPartitionCount(), PostingList(posting_storage_));
+    document_freqs_.resize(terms_.GetSize());
+    log_document_freqs_.resize(terms_.GetSize());
+
+    // Postings of the batch are bucketed by posting key; documents are visited in ordinal order,
+    // so every bucket is already sorted and is appended to its list by a single task
+    struct BatchPosting {
+        int ordinal;
+        double term_freq;
+    };
+    std::vector<size_t> key_offsets(key_posting_counts.size() + 1, 0);
+    std::vector<TermId> batch_keys;
+    for (size_t key = 0; key < key_posting_counts.size(); ++key) {
+        key_offsets[key + 1] = key_offsets[key] + key_posting_counts[key];
+        if (key_posting_counts[key] > 0) {
+            batch_keys.push_back(static_cast<TermId>(key));
+        }
+    }
+    std::vector<BatchPosting> postings(key_offsets.back());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const auto& word_freqs = parsed_documents[i].word_freqs;
+        for (size_t j = 0; j < word_freqs.size(); ++j) {
+            const TermId key = GetPostingKey(batch_data[i]->terms_storage[j], batch_data[i]->status);
+            postings[key_offsets[key]++] = {batch_data[i]->ordinal, word_freqs[j].second};
+        }
+    }
+    // key_offsets[key] now points past the bucket of the key, which starts at key_offsets[key] - count
+    std::for_each(policy, batch_keys.begin(), batch_keys.end(), [&](const TermId key) {
+        auto& key_postings = word_to_document_freqs_[key];
+        for (size_t i = key_offsets[key] - key_posting_counts[key]; i < key_offsets[key]; ++i) {
+            key_postings.Add(postings[i].ordinal, postings[i].term_freq);
+        }
+    });
+    // Partitions of a term share its document count; keys of a term are adjacent
+    std::vector<TermId> batch_terms;
+    for (const TermId key : batch_keys) {
+        const TermId term = key / GetPartitionCount();
+        if (batch_terms.empty() || batch_terms.back() != term) {
+            batch_terms.push_back(term);
         }
+        document_freqs_[term] += static_cast<int>(key_posting_counts[key]);
     }
+    std::for_each(policy, batch_terms.begin(), batch_terms.end(), [&](const TermId term) {
+        UpdateLogDocumentFreq(term);
+    });
 
-    for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    // Forward indexes of different documents are independent; terms are in word order so far
+    std::vector<size_t> indexes(documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](const size_t i) {
+        DocumentData& document_data = *batch_data[i];
+        const auto& word_freqs = parsed_documents[i].word_freqs;
+        std::vector<std::pair<TermId, double>> term_freqs(word_freqs.size());
+        for (size_t j = 0; j < word_freqs.size(); ++j) {
+            term_freqs[j] = {document_data.terms_storage[j], word_freqs[j].second};
+        }
+        std::sort(term_freqs.begin(), term_freqs.end());
+        document_data.term_freqs_storage.resize(term_freqs.size());
+        for (size_t j = 0; j < term_freqs.size(); ++j) {
+            document_data.terms_storage[j] = term_freqs[j].first;
+            document_data.term_freqs_storage[j] = term_freqs[j].second;
+        }
+        document_data.UseStorage();
+    });
+    UpdateLogDocumentCount();
+    SealWriteBufferIfFull();
+}
+
+template <typename Function>
+void SearchServer::ForEachKeyPostings(const SegmentSet::Segments& segments, TermId key, OrdinalRange range, Function function) const {
+    for (const auto& segment : segments) {
+        if (segment->GetFirstOrdinal() >= range.last) {
+            return;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        if (segment->GetLastOrdinal() > range.first) {
+            if (const PostingList* postings = segment->FindPostings(key)) {
+                function(*postings);
+            }
         }
     }
+    if (buffer_first_ordinal_ < range.last && key < word_to_document_freqs_.size() && !word_to_document_freqs_[key].IsEmpty()) {
+        function(word_to_document_freqs_[key]);
+    }
+}
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-                {document_id, relevance, documents_.at(document_id).rating});
+template <typename Function>
+void SearchServer::ForEachPostings(const SegmentSet::Segments& segments, TermId term, OrdinalRange range, Function function) const {
+    for (TermId partition = 0; partition < GetPartitionCount(); ++partition) {
+        ForEachKeyPostings(segments, term * GetPartitionCount() + partition, range, function);
     }
-    return matched_documents;
+}
+
+template <typename Function>
+void SearchServer::ForEachPostings(const SegmentSet::Segments& segments, TermId term, DocumentStatus status, OrdinalRange range, Function function) const {
+    ForEachKeyPostings(segments, GetPostingKey(term, status), range, function);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+bool SearchServer::AcceptsDocument(const DocumentPredicate& document_predicate, int ordinal) const {
+    if constexpr (std::is_same_v<DocumentPredicate, AcceptAll>) {
+        return true;
+    } else if constexpr (std::is_same_v<DocumentPredicate, StatusIs>) {
+        return ordinal_statuses_[ordinal] == document_predicate.status;
+    } else if constexpr (std::is_same_v<DocumentPredicate, RatingBetween>) {
+        return ordinal_ratings_[ordinal] >= document_predicate.min_rating && ordinal_ratings_[ordinal] <= document_predicate.max_rating;
+    } else {
+        return document_predicate(ordinal_to_document_id_[ordinal], ordinal_statuses_[ordinal], ordinal_ratings_[ordinal]);
+    }
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(100);
-    std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), [&] (const auto& plus_word) {
-        if (word_to_document_freqs_.count(plus_word) == 0) {
-            return;
+std::vector<Document> SearchServer::FindAllDocumentsInRange(const SegmentSet::Segments& segments, const Query& query, DocumentPredicate document_predicate, OrdinalRange range) const {
+    // The table is indexed by the offset of an ordinal inside the range
+    auto& document_to_relevance = ScoreAccumulator::GetForCurrentThread();
+    document_to_relevance.Prepare(range.last - range.first);
+    // A status filter only needs the postings of its status
+    const auto for_each_postings = [&](const TermId term, const auto& function) {
+        if constexpr (std::is_same_v<DocumentPredicate, StatusIs>) {
+            ForEachPostings(segments, term, document_predicate.status, range, function);
+        } else {
+            ForEachPostings(segments, term, range, function);
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(plus_word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(plus_word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-            }
-        }
-    });
+    };
+    for (const TermId term : query.minus_words) {
+        for_each_postings(term, [&](const PostingList& postings) {
+            postings.ForEachInRange(range.first, range.last, [&](int ordinal, double) {
+                document_to_relevance.Exclude(ordinal - range.first);
+            });
+        });
+    }
 
-    std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&] (const auto& minus_word) {
-        if (word_to_document_freqs_.count(minus_word) == 0) {
-            return;
-        }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(minus_word)) {
-            document_to_relevance.Erase(document_id);
+    for (const TermId term : query.plus_words) {
+        if (document_freqs_[term] == 0) {
+            continue;
         }
-    });
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(term);
+        for_each_postings(term, [&](const PostingList& postings) {
+            postings.ForEachInRange(range.first, range.last, [&](int ordinal, double term_freq) {
+                const size_t slot = ordinal - range.first;
+                if (document_to_relevance.IsExcluded(slot)) {
+                    return;
+                }
+                // The predicate is asked once per document, a rejected or removed document
+                // is excluded like a minus word match
+                if (!document_to_relevance.IsScored(slot)) {
+                    if (segments_->IsRemoved(ordinal)) {
+                        document_to_relevance.Exclude(slot);
+                        return;
+                    }
+                    if (!AcceptsDocument(document_predicate, ordinal)) {
+                        document_to_relevance.Exclude(slot);
+                        return;
+                    }
+                }
+                document_to_relevance.Add(slot, term_freq * inverse_document_freq);
+            });
+        });
+    }
+
     std::vector<Document> matched_documents;
-    for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
+    document_to_relevance.ForEachScored([&](size_t slot, double relevance) {
+        const int ordinal = range.first + static_cast<int>(slot);
         matched_documents.push_back(
-                {document_id, relevance, documents_.at(document_id).rating});
-    }
+                {ordinal_to_document_id_[ordinal], relevance, ordinal_ratings_[ordinal]});
+    });
     return matched_documents;
 }
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const {
+    return FindAllDocumentsInRange(segments_->GetSegments(), query, document_predicate, {0, static_cast<int>(ordinal_to_document_id_.size())});
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
+    return FindAllDocuments(std::execution::seq, query, document_predicate);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsByRanges(const Query& query, DocumentPredicate document_predicate, size_t max_result_count) const {
+    // Each worker scores a disjoint ordinal range across all query terms in its own table and keeps
+    // only its local top; the locals are merged at the end. No locks are taken, and every
+    // document sums its terms in the same order as in the sequential path
+    const auto ranges = SplitIntoOrdinalRanges();
+    const auto segments = segments_->GetSegments();
+    std::vector<std::vector<Document>> range_top_documents(ranges.size());
+    std::transform(std::execution::par, ranges.begin(), ranges.end(), range_top_documents.begin(),
+                   [&](const OrdinalRange range) {
+                       auto documents = FindAllDocumentsInRange(segments, query, document_predicate, range);
+                       SelectTopDocuments(std::execution::seq, documents, max_result_count);
+                       return documents;
+                   });
+
+    size_t candidate_count = 0;
+    for (const auto& documents : range_top_documents) {
+        candidate_count += documents.size();
+    }
+    std::vector<Document> top_documents;
+    top_documents.reserve(candidate_count);
+    for (const auto& documents : range_top_documents) {
+        top_documents.insert(top_documents.end(), documents.begin(), documents.end());
+    }
+    SelectTopDocuments(std::execution::seq, top_documents, max_result_count);
+    return top_documents;
+}
@@ -0,0 +1,150 @@
+#include "segment_set.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <utility>
+
+SegmentSet::SegmentSet(PostingStorage storage)
+        : storage_(storage)
+{
+}
+
+SegmentSet::SegmentSet(const SegmentSet& other)
+        : storage_(other.storage_)
+{
+    std::lock_guard lock(other.mutex_);
+    segments_ = other.segments_;
+    is_removed_ = other.is_removed_;
+    if (!segments_.empty()) {
+        merge_thread_ = std::thread([this] { RunMerges(); });
+    }
+}
+
+SegmentSet::~SegmentSet() {
+    {
+        std::lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    merge_needed_.notify_one();
+    if (merge_thread_.joinable()) {
+        merge_thread_.join();
+    }
+}
+
+void SegmentSet::AddSegment(IndexSegment segment) {
+    {
+        std::lock_guard lock(mutex_);
+        segments_.push_back(std::make_shared<const IndexSegment>(std::move(segment)));
+        // Small indexes never seal a segment and do without the thread
+        if (!merge_thread_.joinable()) {
+            merge_thread_ = std::thread([this] { RunMerges(); });
+        }
+    }
+    merge_needed_.notify_one();
+}
+
+SegmentSet::Segments SegmentSet::GetSegments() const {
+    std::lock_guard lock(mutex_);
+    return segments_;
+}
+
+void SegmentSet::GetSegments(Segments& segments) const {
+    std::lock_guard lock(mutex_);
+    segments.assign(segments_.begin(), segments_.end());
+}
+
+void SegmentSet::MarkRemoved(int ordinal) {
+    std::lock_guard lock(mutex_);
+    if (static_cast<size_t>(ordinal) >= is_removed_.size()) {
+        is_removed_.resize(ordinal + 1, false);
+    }
+    is_removed_[ordinal] = true;
+}
+
+void SegmentSet::MarkRemoved(const std::vector<int>& ordinals) {
+    if (ordinals.empty()) {
+        return;
+    }
+    std::lock_guard lock(mutex_);
+    const int max_ordinal = *std::max_element(ordinals.begin(), ordinals.end());
+    if (static_cast<size_t>(max_ordinal) >= is_removed_.size()) {
+        is_removed_.resize(max_ordinal + 1, false);
+    }
+    for (const int ordinal : ordinals) {
+        is_removed_[ordinal] = true;
+    }
+}
+
+void SegmentSet::Compact(const std::vector<int>& new_ordinals) {
+    // Holding the rewrite mutex keeps merges out, and the caller keeps out additions
+    std::lock_guard rewrite_lock(rewrite_mutex_);
+    Segments segments = GetSegments();
+    std::vector<size_t> indexes(segments.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](const size_t index) {
+        const IndexSegment& segment = *segments[index];
+        const int first_ordinal = new_ordinals[segment.GetFirstOrdinal()];
+        const int last_ordinal = new_ordinals[segment.GetLastOrdinal()];
+        if (first_ordinal == segment.GetFirstOrdinal() && last_ordinal == segment.GetLastOrdinal()) {
+            return;
+        }
+        segments[index] = first_ordinal == last_ordinal
+                          ? nullptr
+                          : std::make_shared<const IndexSegment>(segment.Renumber(new_ordinals, storage_));
+    });
+    segments.erase(std::remove(segments.begin(), segments.end(), nullptr), segments.end());
+
+    {
+        std::lock_guard lock(mutex_);
+        segments_ = std::move(segments);
+        is_removed_ = std::vector<bool>();
+    }
+    merge_needed_.notify_one();
+}
+
+size_t SegmentSet::FindMergeCandidate() const {
+    for (size_t i = 0; i + 1 < segments_.size(); ++i) {
+        if (static_cast<double>(segments_[i]->GetDocumentCount()) <= MERGE_RATIO * static_cast<double>(segments_[i + 1]->GetDocumentCount())) {
+            return i;
+        }
+    }
+    return segments_.size();
+}
+
+std::vector<bool> SegmentSet::CopyRemoved(int first_ordinal, int last_ordinal) const {
+    std::vector<bool> is_removed(last_ordinal - first_ordinal, false);
+    for (int ordinal = first_ordinal; ordinal < last_ordinal; ++ordinal) {
+        is_removed[ordinal - first_ordinal] = IsRemoved(ordinal);
+    }
+    return is_removed;
+}
+
+void SegmentSet::RunMerges() {
+    while (true) {
+        {
+            std::unique_lock lock(mutex_);
+            merge_needed_.wait(lock, [this] {
+                return is_stopping_ || FindMergeCandidate() < segments_.size();
+            });
+            if (is_stopping_) {
+                return;
+            }
+        }
+        std::lock_guard rewrite_lock(rewrite_mutex_);
+        std::unique_lock lock(mutex_);
+        // A compaction may have changed the list in between
+        const size_t index = FindMergeCandidate();
+        if (index == segments_.size()) {
+            continue;
+        }
+        const Segments pair = {segments_[index], segments_[index + 1]};
+        const auto is_removed = CopyRemoved(pair.front()->GetFirstOrdinal(), pair.back()->GetLastOrdinal());
+
+        lock.unlock();
+        auto merged = std::make_shared<const IndexSegment>(IndexSegment::Merge(pair, is_removed, storage_));
+        lock.lock();
+        segments_[index] = std::move(merged);
+        segments_.erase(segments_.begin() + index + 1);
+    }
+}
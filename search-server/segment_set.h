@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "index_segment.h"
+
+// Sealed segments of an index in ordinal order and the tombstone bitmap of removed ordinals.
+// A background thread merges neighbouring segments of similar size, dropping the removed postings.
+// Readers take a copy of the segment list and keep using it while merges replace segments.
+class SegmentSet {
+public:
+    using Segments = std::vector<std::shared_ptr<const IndexSegment>>;
+
+    // Two neighbours are merged when the older one has at most this many times more documents,
+    // which keeps the number of segments logarithmic in the index size
+    static constexpr double MERGE_RATIO = 1.5;
+
+    explicit SegmentSet(PostingStorage storage);
+    // The copy shares the segments, which are immutable, and merges them on its own
+    SegmentSet(const SegmentSet& other);
+    SegmentSet& operator=(const SegmentSet&) = delete;
+    ~SegmentSet();
+
+    // The segment must start at the last ordinal of the previously added one
+    void AddSegment(IndexSegment segment);
+    Segments GetSegments() const;
+    // Same, into a buffer reused across calls
+    void GetSegments(Segments& segments) const;
+
+    void MarkRemoved(int ordinal);
+    void MarkRemoved(const std::vector<int>& ordinals);
+
+    bool IsRemoved(int ordinal) const {
+        return static_cast<size_t>(ordinal) < is_removed_.size() && is_removed_[ordinal];
+    }
+
+    // Renumbers the ordinals densely and forgets the tombstones; new_ordinals is laid out as for
+    // IndexSegment::Renumber and covers every ordinal given out. Segments without a removed ordinal
+    // up to their end are kept, the others are rebuilt in parallel and dropped if left empty.
+    // Must not run concurrently with AddSegment or MarkRemoved.
+    void Compact(const std::vector<int>& new_ordinals);
+
+private:
+    const PostingStorage storage_;
+    // Taken by whoever replaces segments (merges and compaction), before mutex_
+    std::mutex rewrite_mutex_;
+    mutable std::mutex mutex_;
+    std::condition_variable merge_needed_;
+    Segments segments_;
+    std::vector<bool> is_removed_;
+    bool is_stopping_ = false;
+    std::thread merge_thread_;
+
+    // Index of the older segment of a pair to merge, or segments_.size() if there is none
+    size_t FindMergeCandidate() const;
+    // Tombstones of ordinals in [first_ordinal, last_ordinal), mutex_ must be held
+    std::vector<bool> CopyRemoved(int first_ordinal, int last_ordinal) const;
+    void RunMerges();
+};
@@ -0,0 +1,58 @@
+#include "snapshot_reader.h"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SnapshotReader::SnapshotReader(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open snapshot file "s + path);
+    }
+    struct stat file_stat = {};
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot read snapshot file "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* const mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map snapshot file "s + path);
+        }
+        data_ = static_cast<const char*>(mapping);
+    }
+    close(fd);
+}
+
+SnapshotReader::~SnapshotReader() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+std::string_view SnapshotReader::ReadString() {
+    const auto size = Read<std::uint32_t>();
+    return {ReadBytes(size), size};
+}
+
+bool SnapshotReader::IsAtEnd() const {
+    return offset_ == size_;
+}
+
+const char* SnapshotReader::ReadBytes(size_t size) {
+    if (size > size_ - offset_) {
+        throw std::invalid_argument("Snapshot is truncated"s);
+    }
+    const char* const bytes = data_ + offset_;
+    offset_ += size;
+    return bytes;
+}
+
+void SnapshotReader::Align(size_t alignment) {
+    ReadBytes((alignment - offset_ % alignment) % alignment);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace std::string_literals;
+
+// Maps a snapshot written by SnapshotWriter into memory and reads it back section by section.
+// Arrays are returned as pointers into the mapping and stay valid while the reader lives.
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const std::string& path);
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+    ~SnapshotReader();
+
+    template <typename Value>
+    Value Read();
+    template <typename Value>
+    const Value* ReadArray(size_t count);
+    std::string_view ReadString();
+
+    bool IsAtEnd() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t offset_ = 0;
+
+    const char* ReadBytes(size_t size);
+    void Align(size_t alignment);
+};
+
+template <typename Value>
+Value SnapshotReader::Read() {
+    return *ReadArray<Value>(1);
+}
+
+template <typename Value>
+const Value* SnapshotReader::ReadArray(size_t count) {
+    Align(alignof(Value));
+    if (count > (size_ - offset_) / sizeof(Value)) {
+        throw std::invalid_argument("Snapshot is truncated"s);
+    }
+    return reinterpret_cast<const Value*>(ReadBytes(sizeof(Value) * count));
+}
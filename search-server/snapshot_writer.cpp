@@ -0,0 +1,42 @@
+#include "snapshot_writer.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+        : path_(path)
+        , temporary_path_(path + ".tmp"s)
+        , output_(temporary_path_, std::ios::binary | std::ios::trunc)
+{
+    if (!output_) {
+        throw std::runtime_error("Cannot open snapshot file "s + path);
+    }
+}
+
+void SnapshotWriter::WriteString(const std::string_view text) {
+    Write(static_cast<std::uint32_t>(text.size()));
+    WriteBytes(text.data(), text.size());
+}
+
+void SnapshotWriter::Finish() {
+    output_.flush();
+    if (!output_) {
+        throw std::runtime_error("Cannot write snapshot"s);
+    }
+    output_.close();
+    if (std::rename(temporary_path_.c_str(), path_.c_str()) != 0) {
+        throw std::runtime_error("Cannot replace snapshot file "s + path_);
+    }
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    output_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    offset_ += size;
+}
+
+void SnapshotWriter::Align(size_t alignment) {
+    static const char padding[alignof(std::max_align_t)] = {};
+    WriteBytes(padding, (alignment - offset_ % alignment) % alignment);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+// Writes the sections of an index snapshot. Values are stored in native byte order;
+// arrays are padded to their alignment so that a mapped snapshot can be read in place.
+// The snapshot is written to a temporary file that Finish renames over the path, so a server
+// still reading a previous snapshot at that path keeps its mapped file intact.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    template <typename Value>
+    void Write(const Value& value);
+    template <typename Value>
+    void WriteArray(const Value* values, size_t count);
+    void WriteString(const std::string_view text);
+
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream output_;
+    size_t offset_ = 0;
+
+    void WriteBytes(const void* data, size_t size);
+    void Align(size_t alignment);
+};
+
+template <typename Value>
+void SnapshotWriter::Write(const Value& value) {
+    WriteArray(&value, 1);
+}
+
+template <typename Value>
+void SnapshotWriter::WriteArray(const Value* values, size_t count) {
+    Align(alignof(Value));
+    WriteBytes(values, sizeof(Value) * count);
+}
@@ -0,0 +1,62 @@
+#include "stop_word_set.h"
+
+#include <algorithm>
+#include <functional>
+
+StopWordSet::StopWordSet(const std::set<std::string, std::less<>>& words)
+        : words_(words.begin(), words.end())
+{
+    size_t slot_count = 1;
+    while (slot_count < words_.size() * 2) {
+        slot_count *= 2;
+    }
+    slots_.resize(slot_count);
+    slot_mask_ = slot_count - 1;
+    for (size_t i = 0; i < words_.size(); ++i) {
+        const std::string& word = words_[i];
+        const size_t hash = Hash(word);
+        size_t slot = hash & slot_mask_;
+        while (slots_[slot].word_index != EMPTY_SLOT) {
+            slot = (slot + 1) & slot_mask_;
+        }
+        slots_[slot] = {hash, static_cast<uint32_t>(i)};
+        if (!word.empty()) {
+            lengths_ |= uint64_t{1} << std::min(word.size(), MAX_DISTINCT_LENGTH);
+            const auto first_byte = static_cast<unsigned char>(word[0]);
+            first_bytes_[first_byte / 64] |= uint64_t{1} << (first_byte % 64);
+        }
+    }
+}
+
+bool StopWordSet::Contains(const std::string_view word) const {
+    if (word.empty() || ((lengths_ >> std::min(word.size(), MAX_DISTINCT_LENGTH)) & 1) == 0) {
+        return false;
+    }
+    const auto first_byte = static_cast<unsigned char>(word[0]);
+    if (((first_bytes_[first_byte / 64] >> (first_byte % 64)) & 1) == 0) {
+        return false;
+    }
+    const size_t hash = Hash(word);
+    for (size_t slot = hash & slot_mask_; slots_[slot].word_index != EMPTY_SLOT; slot = (slot + 1) & slot_mask_) {
+        if (slots_[slot].hash == hash && words_[slots_[slot].word_index] == word) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t StopWordSet::GetSize() const {
+    return words_.size();
+}
+
+std::vector<std::string>::const_iterator StopWordSet::begin() const {
+    return words_.begin();
+}
+
+std::vector<std::string>::const_iterator StopWordSet::end() const {
+    return words_.end();
+}
+
+size_t StopWordSet::Hash(const std::string_view word) {
+    return std::hash<std::string_view>{}(word);
+}
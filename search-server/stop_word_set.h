@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable set of stop words, built once by the search server. Words are kept in an open
+// addressing table with their precomputed hashes, at most half full. Most words that are not
+// stop words are rejected before hashing, by bitmaps of the stop word lengths and first bytes.
+class StopWordSet {
+public:
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+
+    bool Contains(const std::string_view word) const;
+    size_t GetSize() const;
+
+    // Words in ascending order
+    std::vector<std::string>::const_iterator begin() const;
+    std::vector<std::string>::const_iterator end() const;
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+    // Lengths from this one on share the last bit of the length bitmap
+    static constexpr size_t MAX_DISTINCT_LENGTH = 63;
+
+    struct Slot {
+        size_t hash;
+        uint32_t word_index = EMPTY_SLOT;
+    };
+
+    std::vector<std::string> words_;
+    std::vector<Slot> slots_;
+    size_t slot_mask_ = 0;
+    uint64_t lengths_ = 0;
+    std::array<uint64_t, 4> first_bytes_ = {};
+
+    static size_t Hash(const std::string_view word);
+};
@@ -0,0 +1,21 @@
+#include "string_arena.h"
+
+#include <algorithm>
+
+std::string_view StringArena::Store(const std::string_view text) {
+    if (text.size() > chunk_free_) {
+        // Oversized strings get a chunk of their own, the current chunk stays open
+        if (text.size() > CHUNK_SIZE / 4) {
+            auto& chunk = chunks_.emplace_back(new char[text.size()]);
+            std::copy(text.begin(), text.end(), chunk.get());
+            return {chunk.get(), text.size()};
+        }
+        chunk_position_ = chunks_.emplace_back(new char[CHUNK_SIZE]).get();
+        chunk_free_ = CHUNK_SIZE;
+    }
+    char* const stored = chunk_position_;
+    std::copy(text.begin(), text.end(), stored);
+    chunk_position_ += text.size();
+    chunk_free_ -= text.size();
+    return {stored, text.size()};
+}
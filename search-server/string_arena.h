@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Bump allocator for immutable strings: text is copied into large chunks and is
+// released only together with the arena. Views returned by Store stay valid until then.
+class StringArena {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    std::string_view Store(const std::string_view text);
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    size_t chunk_free_ = 0;
+    char* chunk_position_ = nullptr;
+};
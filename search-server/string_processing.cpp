@@ -1,16 +1,121 @@
 #include "string_processing.h"
 
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Text is scanned in blocks of 32 bytes; bit i of a mask describes byte i of the block
+constexpr size_t BLOCK_SIZE = 32;
+
+struct BlockMasks {
+    uint32_t spaces;
+    uint32_t controls;
+};
+
+// Bytes past the end of the text count as spaces, so the last word ends inside the block
+BlockMasks ScanTail(const char* data, size_t size) {
+    BlockMasks masks{~uint32_t{0}, 0};
+    for (size_t i = 0; i < size; ++i) {
+        const auto byte = static_cast<unsigned char>(data[i]);
+        if (byte != ' ') {
+            masks.spaces &= ~(uint32_t{1} << i);
+        }
+        if (byte < ' ') {
+            masks.controls |= uint32_t{1} << i;
+        }
+    }
+    return masks;
+}
+
+#if defined(__AVX2__)
+BlockMasks ScanBlock(const char* data) {
+    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    const __m256i spaces = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+    // Unsigned byte <= 0x1F: the minimum with 0x1F leaves exactly those bytes unchanged
+    const __m256i controls = _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, _mm256_set1_epi8(0x1F)), bytes);
+    return {static_cast<uint32_t>(_mm256_movemask_epi8(spaces)), static_cast<uint32_t>(_mm256_movemask_epi8(controls))};
+}
+#elif defined(__SSE2__)
+BlockMasks ScanBlock(const char* data) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i last_control = _mm_set1_epi8(0x1F);
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+    // Unsigned byte <= 0x1F: the minimum with 0x1F leaves exactly those bytes unchanged
+    const uint32_t spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, space)))
+                            | static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, space))) << 16;
+    const uint32_t controls = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(low, last_control), low)))
+                              | static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(high, last_control), high))) << 16;
+    return {spaces, controls};
+}
+#else
+BlockMasks ScanBlock(const char* data) {
+    return ScanTail(data, BLOCK_SIZE);
+}
+#endif
+
+int CountTrailingZeros(uint32_t value) {
+#if defined(__GNUC__)
+    return __builtin_ctz(value);
+#else
+    int count = 0;
+    while ((value & 1) == 0) {
+        value >>= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+}  // namespace
 
 std::vector<std::string_view> SplitIntoWords(const std::string_view text) {
     std::vector<std::string_view> words;
-    std::size_t start = 0;
-    for (std::size_t i = 0; i <= text.size(); ++i) {
-        if (i == text.size() || text[i] == ' ') {
-            if (i > start) {
-                words.push_back(text.substr(start, i - start));
-                start = i + 1;
+    SplitIntoWords(text, words);
+    return words;
+}
+
+bool SplitIntoWords(const std::string_view text, std::vector<std::string_view>& words) {
+    words.clear();
+    uint32_t controls = 0;
+    size_t word_start = 0;
+    bool is_after_space = true;
+    for (size_t block_start = 0; block_start < text.size(); block_start += BLOCK_SIZE) {
+        const BlockMasks masks = block_start + BLOCK_SIZE <= text.size()
+                                 ? ScanBlock(text.data() + block_start)
+                                 : ScanTail(text.data() + block_start, text.size() - block_start);
+        controls |= masks.controls;
+        // A set bit marks a byte whose kind (space or not) differs from the byte before it:
+        // a word starts at a non-space one and ends at a space one
+        uint32_t boundaries = masks.spaces ^ ((masks.spaces << 1) | (is_after_space ? 1 : 0));
+        while (boundaries != 0) {
+            const int offset = CountTrailingZeros(boundaries);
+            const size_t position = block_start + offset;
+            if ((masks.spaces >> offset) & 1) {
+                words.push_back(text.substr(word_start, position - word_start));
+            } else {
+                word_start = position;
             }
+            boundaries &= boundaries - 1;
         }
+        is_after_space = masks.spaces >> (BLOCK_SIZE - 1);
     }
-    return words;
-}
\ No newline at end of file
+    if (!is_after_space) {
+        words.push_back(text.substr(word_start));
+    }
+    return controls == 0;
+}
+
+bool HasControlCharacters(const std::string_view text) {
+    size_t block_start = 0;
+    for (; block_start + BLOCK_SIZE <= text.size(); block_start += BLOCK_SIZE) {
+        if (ScanBlock(text.data() + block_start).controls != 0) {
+            return true;
+        }
+    }
+    return ScanTail(text.data() + block_start, text.size() - block_start).controls != 0;
+}
@@ -2,10 +2,18 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <set>
 
 std::vector<std::string_view> SplitIntoWords(const std::string_view text);
 
+// Splits text into words separated by any number of spaces, replacing the content of words:
+// a buffer reused across calls stops allocating once it is large enough. Control characters
+// (bytes 0x00-0x1F) are looked for in the same pass; returns false if text holds any.
+bool SplitIntoWords(const std::string_view text, std::vector<std::string_view>& words);
+
+bool HasControlCharacters(const std::string_view text);
+
 template<typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -15,4 +23,4 @@ std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContain
         }
     }
     return non_empty_strings;
-}
\ No newline at end of file
+}
@@ -0,0 +1,42 @@
+#include "term_dictionary.h"
+
+TermDictionary::TermDictionary(const TermDictionary& other) {
+    words_.reserve(other.words_.size());
+    ids_.reserve(other.words_.size());
+    for (const std::string_view word : other.words_) {
+        Intern(word);
+    }
+}
+
+TermId TermDictionary::Intern(const std::string_view word) {
+    if (const auto it = ids_.find(word); it != ids_.end()) {
+        return it->second;
+    }
+    const auto term = static_cast<TermId>(words_.size());
+    const std::string_view stored = words_.emplace_back(storage_.Store(word));
+    ids_.emplace(stored, term);
+    return term;
+}
+
+TermId TermDictionary::InternStable(const std::string_view word) {
+    if (const auto it = ids_.find(word); it != ids_.end()) {
+        return it->second;
+    }
+    const auto term = static_cast<TermId>(words_.size());
+    words_.push_back(word);
+    ids_.emplace(word, term);
+    return term;
+}
+
+TermId TermDictionary::Find(const std::string_view word) const {
+    const auto it = ids_.find(word);
+    return it == ids_.end() ? NO_TERM : it->second;
+}
+
+std::string_view TermDictionary::GetWord(TermId term) const {
+    return words_[term];
+}
+
+size_t TermDictionary::GetSize() const {
+    return words_.size();
+}
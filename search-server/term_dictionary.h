@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "string_arena.h"
+
+using TermId = std::uint32_t;
+
+// Interns every distinct word of the index once and hands out dense ids,
+// so posting lists and query terms can be addressed by integers.
+// Word storage is stable: views returned by GetWord stay valid for the dictionary lifetime.
+class TermDictionary {
+public:
+    static constexpr TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+    TermDictionary() = default;
+    // The copy stores its own words and gives them the same ids
+    TermDictionary(const TermDictionary& other);
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(const TermDictionary&) = delete;
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    TermId Intern(const std::string_view word);
+    // Same for a word that outlives the dictionary, e.g. in a mapped snapshot: it is not copied
+    TermId InternStable(const std::string_view word);
+    TermId Find(const std::string_view word) const;
+    std::string_view GetWord(TermId term) const;
+    size_t GetSize() const;
+
+private:
+    StringArena storage_;
+    std::vector<std::string_view> words_;
+    std::unordered_map<std::string_view, TermId> ids_;
+};
@@ -0,0 +1,872 @@
+#include "tests.h"
+
+#include <algorithm>
+#include <climits>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "concurrent_search_server.h"
+#include "posting_list.h"
+#include "process_queries.h"
+#include "query_executor.h"
+#include "request_queue.h"
+#include "result_cache.h"
+#include "search_server.h"
+#include "string_processing.h"
+
+using namespace std::string_literals;
+using namespace std::string_view_literals;
+
+namespace {
+
+void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line,
+                const std::string& hint) {
+    if (!value) {
+        std::cerr << file << "("s << line << "): "s << func << ": "s;
+        std::cerr << "ASSERT("s << expr_str << ") failed."s;
+        if (!hint.empty()) {
+            std::cerr << " Hint: "s << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+template <typename T, typename U>
+void AssertEqualImpl(const T& t, const U& u, const std::string& t_str, const std::string& u_str, const std::string& file,
+                     const std::string& func, unsigned line, const std::string& hint) {
+    if (t != u) {
+        std::cerr << std::boolalpha;
+        std::cerr << file << "("s << line << "): "s << func << ": "s;
+        std::cerr << "ASSERT_EQUAL("s << t_str << ", "s << u_str << ") failed: "s;
+        std::cerr << t << " != "s << u << "."s;
+        if (!hint.empty()) {
+            std::cerr << " Hint: "s << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+template <typename TestFunc>
+void RunTestImpl(const TestFunc& func, const std::string& test_name) {
+    func();
+    std::cerr << test_name << " OK"s << std::endl;
+}
+
+}  // namespace
+
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, ""s)
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, ""s)
+#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
+#define RUN_TEST(func) RunTestImpl((func), #func)
+
+namespace {
+
+const std::vector<DocumentStatus> ALL_STATUSES = {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT,
+                                                  DocumentStatus::BANNED, DocumentStatus::REMOVED};
+
+// Lower word indexes are much more frequent, so that some posting lists are long
+std::string GenerateText(std::mt19937& generator, int dictionary_size, int word_count, double minus_prob = 0.0) {
+    std::string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (std::uniform_real_distribution<>(0.0, 1.0)(generator) < minus_prob) {
+            text.push_back('-');
+        }
+        const double position = std::uniform_real_distribution<>(0.0, 1.0)(generator);
+        text += "w"s + std::to_string(static_cast<int>(dictionary_size * position * position * position));
+    }
+    return text;
+}
+
+DocumentStatus GenerateStatus(std::mt19937& generator) {
+    return ALL_STATUSES[std::uniform_int_distribution<size_t>(0, ALL_STATUSES.size() - 1)(generator)];
+}
+
+void AddRandomDocuments(SearchServer& search_server, std::mt19937& generator, int first_id, int count, int dictionary_size) {
+    for (int id = first_id; id < first_id + count; ++id) {
+        search_server.AddDocument(id, GenerateText(generator, dictionary_size, std::uniform_int_distribution(1, 12)(generator)),
+                                  GenerateStatus(generator), {std::uniform_int_distribution(-10, 10)(generator)});
+    }
+}
+
+// The documents must be the expected top in order, up to documents of equal relevance
+void CheckSameTop(const std::vector<Document>& documents, const std::vector<Document>& expected,
+                  const std::map<int, double>& relevances, const std::string& hint) {
+    ASSERT_EQUAL_HINT(documents.size(), expected.size(), hint);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        ASSERT_HINT(std::abs(documents[i].relevance - expected[i].relevance) <= 1e-9, hint);
+        const auto it = relevances.find(documents[i].id);
+        ASSERT_HINT(it != relevances.end() && std::abs(it->second - documents[i].relevance) <= 1e-9, hint);
+    }
+}
+
+void CheckTopDocuments(const SearchServer& search_server, std::mt19937& generator, int dictionary_size, const std::string& config) {
+    std::vector<std::string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back(GenerateText(generator, dictionary_size, std::uniform_int_distribution(1, 6)(generator), 0.2));
+    }
+    for (const DocumentStatus status : ALL_STATUSES) {
+        const size_t max_result_count = std::uniform_int_distribution<size_t>(1, 20)(generator);
+        const auto batch_results = search_server.FindTopDocumentsBatch(queries, status, max_result_count);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const std::string hint = config + ", query \""s + queries[i] + "\", status "s + std::to_string(static_cast<int>(status));
+            // A lambda is not recognized as a status filter and takes the exhaustive path
+            const auto all_documents = search_server.FindTopDocuments(queries[i], [status](int, DocumentStatus document_status, int) {
+                return document_status == status;
+            }, std::numeric_limits<size_t>::max());
+            std::map<int, double> relevances;
+            for (const Document& document : all_documents) {
+                relevances[document.id] = document.relevance;
+            }
+            const std::vector<Document> expected(all_documents.begin(),
+                                                 all_documents.begin() + std::min(max_result_count, all_documents.size()));
+
+            CheckSameTop(search_server.FindTopDocuments(queries[i], status, max_result_count), expected, relevances, hint);
+            CheckSameTop(search_server.FindTopDocuments(std::execution::par, queries[i], status, max_result_count), expected, relevances, hint);
+            CheckSameTop(batch_results[i], expected, relevances, hint);
+        }
+    }
+}
+
+void CheckPrunedTopDocuments(PostingStorage storage, PostingPartitioning partitioning, int document_count) {
+    const std::string config = "storage "s + std::to_string(static_cast<int>(storage)) + ", partitioning "s
+                               + std::to_string(static_cast<int>(partitioning)) + ", "s + std::to_string(document_count) + " documents"s;
+    constexpr int DICTIONARY_SIZE = 500;
+    std::mt19937 generator;
+    SearchServer search_server("w3 w7"s, storage, partitioning);
+    AddRandomDocuments(search_server, generator, 0, document_count, DICTIONARY_SIZE);
+    CheckTopDocuments(search_server, generator, DICTIONARY_SIZE, config);
+
+    std::vector<int> removed_ids;
+    for (int id = 0; id < document_count; ++id) {
+        const int action = std::uniform_int_distribution(0, 9)(generator);
+        if (action == 0) {
+            search_server.RemoveDocument(id);
+        } else if (action == 1) {
+            search_server.RemoveDocument(std::execution::par, id);
+        } else if (action == 2) {
+            removed_ids.push_back(id);
+        } else if (action == 3) {
+            search_server.SetDocumentStatus(id, GenerateStatus(generator));
+        }
+    }
+    search_server.RemoveDocuments(removed_ids);
+    CheckTopDocuments(search_server, generator, DICTIONARY_SIZE, config + ", after removals"s);
+
+    search_server.CompactIndex();
+    CheckTopDocuments(search_server, generator, DICTIONARY_SIZE, config + ", after compaction"s);
+    AddRandomDocuments(search_server, generator, document_count, document_count / 10, DICTIONARY_SIZE);
+    CheckTopDocuments(search_server, generator, DICTIONARY_SIZE, config + ", after compaction and additions"s);
+
+    // Every round moves documents to new ordinals, which the compaction renumbers
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    for (int round = 0; round < 3; ++round) {
+        for (const int id : document_ids) {
+            if (std::uniform_int_distribution(0, 1)(generator) == 0) {
+                search_server.SetDocumentStatus(id, GenerateStatus(generator));
+            }
+        }
+        search_server.CompactIndex();
+    }
+    CheckTopDocuments(search_server, generator, DICTIONARY_SIZE, config + ", after repeated compactions"s);
+}
+
+// Removes documents and changes statuses of first_id <= id < last_id with the generator
+void ApplyRandomChanges(SearchServer& search_server, std::mt19937 generator, int first_id, int last_id) {
+    const std::set<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<int> removed_ids;
+    for (int id = first_id; id < last_id; ++id) {
+        const int action = std::uniform_int_distribution(0, 9)(generator);
+        if (action == 0) {
+            search_server.RemoveDocument(std::execution::par, id);
+        } else if (action == 1) {
+            removed_ids.push_back(id);
+        } else if (action == 2 && document_ids.count(id) > 0) {
+            search_server.SetDocumentStatus(id, GenerateStatus(generator));
+        }
+    }
+    search_server.RemoveDocuments(removed_ids);
+}
+
+// Both servers must hold the same documents and find the same tops, ordinals may differ
+void CheckSameIndex(const SearchServer& expected_server, const SearchServer& search_server, std::mt19937& generator,
+                    int dictionary_size, const std::string& hint) {
+    ASSERT_HINT(std::equal(expected_server.begin(), expected_server.end(), search_server.begin(), search_server.end()), hint);
+    for (const int id : expected_server) {
+        ASSERT_HINT(expected_server.GetWordFrequencies(id) == search_server.GetWordFrequencies(id), hint);
+    }
+    for (int i = 0; i < 100; ++i) {
+        const std::string query = GenerateText(generator, dictionary_size, std::uniform_int_distribution(1, 6)(generator), 0.2);
+        const DocumentStatus status = GenerateStatus(generator);
+        const auto all_documents = expected_server.FindTopDocuments(query, StatusIs{status}, std::numeric_limits<size_t>::max());
+        std::map<int, double> relevances;
+        for (const Document& document : all_documents) {
+            relevances[document.id] = document.relevance;
+        }
+        CheckSameTop(search_server.FindTopDocuments(query, status, 10), expected_server.FindTopDocuments(query, status, 10),
+                     relevances, hint + ", query \""s + query + "\""s);
+        if (!all_documents.empty()) {
+            const int id = all_documents.front().id;
+            ASSERT_HINT(expected_server.MatchDocument(query, id) == search_server.MatchDocument(query, id), hint);
+        }
+    }
+}
+
+void CheckSnapshot(PostingStorage storage, PostingPartitioning partitioning) {
+    const std::string config = "storage "s + std::to_string(static_cast<int>(storage)) + ", partitioning "s
+                               + std::to_string(static_cast<int>(partitioning));
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_test.snapshot").string();
+    constexpr int DICTIONARY_SIZE = 500;
+    constexpr int DOCUMENT_COUNT = 3000;
+    std::mt19937 generator;
+    SearchServer search_server("w3 w7"s, storage, partitioning);
+    AddRandomDocuments(search_server, generator, 0, DOCUMENT_COUNT, DICTIONARY_SIZE);
+    ApplyRandomChanges(search_server, generator, 0, DOCUMENT_COUNT / 2);
+
+    search_server.SaveSnapshot(path);
+    SearchServer loaded_server = SearchServer::LoadSnapshot(path);
+    CheckSameIndex(search_server, loaded_server, generator, DICTIONARY_SIZE, config + ", loaded"s);
+
+    // Changes of the mapped segment: removals, status changes, compaction, new documents
+    std::mt19937 change_generator(1);
+    for (SearchServer* server : {&search_server, &loaded_server}) {
+        std::mt19937 server_generator = change_generator;
+        ApplyRandomChanges(*server, server_generator, 0, DOCUMENT_COUNT);
+        server->CompactIndex();
+        AddRandomDocuments(*server, server_generator, DOCUMENT_COUNT, DOCUMENT_COUNT / 10, DICTIONARY_SIZE);
+    }
+    CheckTopDocuments(loaded_server, generator, DICTIONARY_SIZE, config + ", changed after loading"s);
+    // A compressed list quantizes a posting once it lands in a block, which depends on the layout
+    // of the list: the two copies may differ within the quantization error
+    if (storage == PostingStorage::PLAIN) {
+        CheckSameIndex(search_server, loaded_server, generator, DICTIONARY_SIZE, config + ", changed after loading"s);
+    }
+
+    // Saving over the loaded file leaves the mapping of the loaded server intact
+    loaded_server.SaveSnapshot(path);
+    CheckSameIndex(SearchServer::LoadSnapshot(path), loaded_server, generator, DICTIONARY_SIZE, config + ", saved over"s);
+
+    std::string data;
+    {
+        std::ifstream input(path, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    }
+    const auto check_rejected = [&](const std::string& corrupt_data, const std::string& corruption) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << corrupt_data;
+        try {
+            SearchServer::LoadSnapshot(path);
+            ASSERT_HINT(false, config + ", "s + corruption);
+        } catch (const std::invalid_argument&) {
+        }
+    };
+    check_rejected(data.substr(0, data.size() - 1), "truncated"s);
+    check_rejected(data + "x"s, "trailing data"s);
+    std::string wrong_version = data;
+    wrong_version[sizeof(std::uint64_t)] = 99;
+    check_rejected(wrong_version, "unknown version"s);
+    std::filesystem::remove(path);
+}
+
+// Peak resident memory in kB since the last ResetPeakMemory, 0 where the kernel does not report it
+size_t GetPeakMemory() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:"s, 0) == 0) {
+            return std::stoul(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+void ResetPeakMemory() {
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+// Byte-by-byte reference for SplitIntoWords: words are the maximal runs of non-space bytes
+std::vector<std::string_view> SplitIntoWordsReference(const std::string_view text) {
+    std::vector<std::string_view> words;
+    size_t word_start = 0;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i == text.size() || text[i] == ' ') {
+            if (i > word_start) {
+                words.push_back(text.substr(word_start, i - word_start));
+            }
+            word_start = i + 1;
+        }
+    }
+    return words;
+}
+
+}  // namespace
+
+void TestSplitIntoWords() {
+    ASSERT(SplitIntoWords(""sv).empty());
+    ASSERT(SplitIntoWords("   "sv).empty());
+    ASSERT((SplitIntoWords("  a  bc   d "sv) == std::vector<std::string_view>{"a"sv, "bc"sv, "d"sv}));
+
+    std::mt19937 generator;
+    // Runs of spaces, bytes next to the space and the control range, control bytes, and high-bit
+    // bytes, which are negative as char but must not be taken for control bytes
+    const std::string alphabet = "    ab!\x1F\t\n"s + '\0' + "\x7F\x80\xA0\xE0\xFF"s;
+    std::string buffer;
+    std::vector<std::string_view> words;
+    for (int attempt = 0; attempt < 20000; ++attempt) {
+        // Lengths around one, two and three 32-byte blocks, starting at any offset of the buffer
+        const auto size = std::uniform_int_distribution<size_t>(0, 100)(generator);
+        const auto offset = std::uniform_int_distribution<size_t>(0, 31)(generator);
+        buffer.clear();
+        for (size_t i = 0; i < offset + size; ++i) {
+            buffer.push_back(alphabet[std::uniform_int_distribution<size_t>(0, alphabet.size() - 1)(generator)]);
+        }
+        const std::string_view text = std::string_view(buffer).substr(offset);
+        const bool has_controls = std::any_of(text.begin(), text.end(), [](char c) {
+            return static_cast<unsigned char>(c) < ' ';
+        });
+        const std::string hint = "size "s + std::to_string(size) + ", offset "s + std::to_string(offset);
+
+        // The buffer is reused across calls and must be cleared each time
+        ASSERT_EQUAL_HINT(SplitIntoWords(text, words), !has_controls, hint);
+        ASSERT_HINT(words == SplitIntoWordsReference(text), hint);
+        ASSERT_EQUAL_HINT(HasControlCharacters(text), has_controls, hint);
+    }
+}
+
+void TestPostingBlockDecoders() {
+    std::mt19937 generator;
+    std::vector<int> document_ids;
+    std::uint16_t term_freqs[PostingList::BLOCK_SIZE] = {};
+    int decoded_ids[PostingList::BLOCK_SIZE];
+    // Every bit width the encoder can choose, with full and partial blocks
+    for (int bit_width = 0; bit_width <= 31; ++bit_width) {
+        for (int attempt = 0; attempt < 20; ++attempt) {
+            const long long max_gap = 1LL << bit_width;
+            const int first_document_id = std::uniform_int_distribution<int>(0, 1 << 20)(generator);
+            const long long max_count = std::min<long long>(PostingList::BLOCK_SIZE, 1 + (INT_MAX - first_document_id) / max_gap);
+            const auto count = static_cast<size_t>(std::uniform_int_distribution<long long>(1, max_count)(generator));
+            document_ids.assign(1, first_document_id);
+            for (size_t i = 1; i < count; ++i) {
+                // One gap of the full width, so that the block gets exactly this bit width
+                const long long gap = i == 1 ? max_gap : std::uniform_int_distribution<long long>(1, max_gap)(generator);
+                document_ids.push_back(static_cast<int>(document_ids.back() + gap));
+            }
+            const PostingList::Block block = PostingList::EncodeBlock(document_ids.data(), term_freqs, count);
+            const std::string hint = "bit width "s + std::to_string(bit_width) + ", count "s + std::to_string(count);
+
+            PostingList::DecodeBlockScalar(block, decoded_ids);
+            const std::vector<int> scalar_ids(decoded_ids, decoded_ids + PostingList::BLOCK_SIZE);
+            ASSERT_HINT(std::equal(document_ids.begin(), document_ids.end(), scalar_ids.begin()), hint);
+#if defined(__SSE2__)
+            PostingList::DecodeBlockSse2(block, decoded_ids);
+            // Padding slots included: the decoders must agree on every slot they write
+            ASSERT_HINT(std::equal(scalar_ids.begin(), scalar_ids.end(), decoded_ids), hint);
+#endif
+        }
+    }
+}
+
+void TestCompressedPostingList() {
+    std::mt19937 generator;
+    for (const int max_gap : {1, 3, 100, 70000}) {
+        std::vector<int> document_ids;
+        std::vector<double> term_freqs;
+        PostingList postings(PostingStorage::COMPRESSED);
+        int document_id = -1;
+        for (int i = 0; i < 1000; ++i) {
+            document_id += std::uniform_int_distribution<int>(1, max_gap)(generator);
+            document_ids.push_back(document_id);
+            term_freqs.push_back(1.0 / std::uniform_int_distribution<int>(1, 200)(generator));
+            postings.Add(document_ids.back(), term_freqs.back());
+        }
+        ASSERT_EQUAL(postings.GetSize(), document_ids.size());
+
+        size_t position = 0;
+        postings.ForEach([&](int id, double term_freq) {
+            ASSERT(position < document_ids.size());
+            ASSERT_EQUAL(id, document_ids[position]);
+            // 12 bits of mantissa
+            ASSERT(std::abs(term_freq - term_freqs[position]) <= term_freqs[position] / 2048.0);
+            ASSERT(term_freq <= postings.GetMaxTermFreq());
+            ++position;
+        });
+        ASSERT_EQUAL(position, document_ids.size());
+
+        const int first_id = document_ids[document_ids.size() / 3];
+        const int last_id = document_ids[document_ids.size() * 2 / 3] + 1;
+        std::vector<int> range_ids;
+        postings.ForEachInRange(first_id, last_id, [&](int id, double) {
+            range_ids.push_back(id);
+        });
+        ASSERT(std::equal(range_ids.begin(), range_ids.end(),
+                          std::lower_bound(document_ids.begin(), document_ids.end(), first_id),
+                          std::lower_bound(document_ids.begin(), document_ids.end(), last_id)));
+
+        PostingList::Cursor cursor(postings);
+        for (int target = 0; target <= document_ids.back() + 1; target += std::uniform_int_distribution<int>(1, 5 * max_gap)(generator)) {
+            cursor.SkipTo(target);
+            const auto expected = std::lower_bound(document_ids.begin(), document_ids.end(), target);
+            ASSERT_EQUAL(cursor.IsAtEnd(), expected == document_ids.end());
+            if (!cursor.IsAtEnd()) {
+                ASSERT_EQUAL(cursor.GetDocumentId(), *expected);
+                ASSERT_EQUAL(postings.Contains(*expected), true);
+            }
+        }
+    }
+}
+
+void TestPrunedTopDocuments() {
+    for (const PostingStorage storage : {PostingStorage::PLAIN, PostingStorage::COMPRESSED}) {
+        for (const PostingPartitioning partitioning : {PostingPartitioning::NONE, PostingPartitioning::BY_STATUS}) {
+            CheckPrunedTopDocuments(storage, partitioning, 3000);
+        }
+    }
+    // Enough ordinals for sealed segments, background merges and several ranges of a parallel query
+    CheckPrunedTopDocuments(PostingStorage::COMPRESSED, PostingPartitioning::BY_STATUS, 40000);
+}
+
+void TestResultCache() {
+    constexpr int DICTIONARY_SIZE = 100;
+    std::mt19937 generator;
+    SearchServer search_server("w3"s);
+    SearchServer expected_server("w3"s);
+    for (int id = 0; id < 500; ++id) {
+        const std::string text = GenerateText(generator, DICTIONARY_SIZE, 8);
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+        expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+    }
+    search_server.EnableResultCache(1 << 20);
+    const auto check_query = [&](const std::string& query, uint64_t hits, uint64_t misses, const std::string& hint) {
+        const auto documents = search_server.FindTopDocuments(query);
+        const auto expected = expected_server.FindTopDocuments(query);
+        ASSERT_EQUAL_HINT(documents.size(), expected.size(), hint);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, hint);
+        }
+        const auto stats = search_server.GetResultCacheStats();
+        ASSERT_EQUAL_HINT(stats.hits, hits, hint);
+        ASSERT_EQUAL_HINT(stats.misses, misses, hint);
+    };
+
+    // Keys are parsed queries: word order and repeated words do not matter, status and count do
+    check_query("w1 w2 -w5"s, 0, 1, "first query"s);
+    check_query("w1 w2 -w5"s, 1, 1, "same query"s);
+    check_query("w2 -w5 w1 w2"s, 2, 1, "reordered query"s);
+    search_server.FindTopDocuments("w1 w2 -w5"s, DocumentStatus::BANNED);
+    search_server.FindTopDocuments("w1 w2 -w5"s, DocumentStatus::ACTUAL, 3);
+    ASSERT_EQUAL(search_server.GetResultCacheStats().misses, uint64_t{3});
+    ASSERT_EQUAL(search_server.GetResultCacheStats().entry_count, size_t{3});
+
+    // Every change of the documents makes the cached results stale
+    search_server.AddDocument(1000, "w1 w2"s, DocumentStatus::ACTUAL, {100});
+    expected_server.AddDocument(1000, "w1 w2"s, DocumentStatus::ACTUAL, {100});
+    check_query("w1 w2 -w5"s, 2, 4, "after AddDocument"s);
+    search_server.RemoveDocument(1000);
+    expected_server.RemoveDocument(1000);
+    check_query("w1 w2 -w5"s, 2, 5, "after RemoveDocument"s);
+    const int top_id = search_server.FindTopDocuments("w1 w2 -w5"s).front().id;
+    search_server.SetDocumentStatus(top_id, DocumentStatus::IRRELEVANT);
+    expected_server.SetDocumentStatus(top_id, DocumentStatus::IRRELEVANT);
+    check_query("w1 w2 -w5"s, 3, 6, "after SetDocumentStatus"s);
+
+    // Least recently used entries leave once the budget is spent, entries over budget never enter
+    const std::vector<Document> documents(5, Document{1, 1.0, 1});
+    const auto make_key = [](TermId term) {
+        return ResultCache::Key{{term}, {}, DocumentStatus::ACTUAL, 5};
+    };
+    ResultCache cache(4096, 1);
+    cache.Insert(make_key(0), 0, documents);
+    const size_t entry_memory = cache.GetStats().memory_usage;
+    const size_t capacity = 4096 / entry_memory;
+    std::vector<Document> found;
+    for (TermId term = 1; term < 2 * capacity; ++term) {
+        cache.Insert(make_key(term), 0, documents);
+        // The first entry is kept by using it
+        ASSERT(cache.Find(make_key(0), 0, found));
+        ASSERT(cache.GetStats().memory_usage <= 4096);
+    }
+    ASSERT_EQUAL(cache.GetStats().entry_count, capacity);
+    ASSERT(!cache.Find(make_key(1), 0, found));
+    ASSERT(cache.Find(make_key(2 * capacity - 1), 0, found));
+    ASSERT(!cache.Find(make_key(0), 1, found));
+    cache.Insert(make_key(0), 0, std::vector<Document>(4096, Document{}));
+    ASSERT(!cache.Find(make_key(0), 0, found));
+
+    // The copies of a concurrent server split the budget, and a write publishes the other copy
+    ConcurrentSearchServer concurrent_server("w3"s);
+    for (int id = 0; id < 500; ++id) {
+        concurrent_server.AddDocument(id, GenerateText(generator, DICTIONARY_SIZE, 8), DocumentStatus::ACTUAL, {1});
+    }
+    constexpr size_t BUDGET = 64 * 1024;
+    concurrent_server.EnableResultCache(BUDGET);
+    for (int i = 0; i < 2000; ++i) {
+        concurrent_server.FindTopDocuments(GenerateText(generator, DICTIONARY_SIZE, 3));
+    }
+    const auto stats = concurrent_server.GetSnapshot()->GetResultCacheStats();
+    ASSERT(stats.entry_count > 0 && stats.memory_usage <= BUDGET / 2);
+    ASSERT(stats.memory_usage > BUDGET / 4);
+    concurrent_server.RemoveDocument(0);
+    ASSERT_EQUAL(concurrent_server.GetSnapshot()->GetResultCacheStats().hits + concurrent_server.GetSnapshot()->GetResultCacheStats().misses, uint64_t{0});
+    for (int i = 0; i < 2000; ++i) {
+        concurrent_server.FindTopDocuments(GenerateText(generator, DICTIONARY_SIZE, 3));
+    }
+    ASSERT(concurrent_server.GetSnapshot()->GetResultCacheStats().memory_usage <= BUDGET / 2);
+}
+
+void TestSnapshot() {
+    for (const PostingStorage storage : {PostingStorage::PLAIN, PostingStorage::COMPRESSED}) {
+        for (const PostingPartitioning partitioning : {PostingPartitioning::NONE, PostingPartitioning::BY_STATUS}) {
+            CheckSnapshot(storage, partitioning);
+        }
+    }
+}
+
+void TestConcurrentSearchServer() {
+    constexpr int DICTIONARY_SIZE = 200;
+    std::mt19937 generator;
+
+    // Held snapshots keep their state and do not hold up writes
+    {
+        ConcurrentSearchServer search_server("w3"s);
+        SearchServer expected_server("w3"s);
+        const auto empty_snapshot = search_server.GetSnapshot();
+        for (int id = 0; id < 100; ++id) {
+            const std::string text = GenerateText(generator, DICTIONARY_SIZE, 8);
+            search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+            expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+        }
+        ASSERT_EQUAL(empty_snapshot->GetDocumentCount(), 0);
+
+        auto snapshot = search_server.GetSnapshot();
+        for (const int id : *snapshot) {
+            if (id % 3 == 0) {
+                search_server.RemoveDocument(id);
+                expected_server.RemoveDocument(id);
+            }
+        }
+        ASSERT_EQUAL(snapshot->GetDocumentCount(), 100);
+        ASSERT_EQUAL(search_server.GetSnapshot()->GetDocumentCount(), expected_server.GetDocumentCount());
+
+        // Once released, both copies take the writes again
+        snapshot.reset();
+        for (int id = 100; id < 110; ++id) {
+            const std::string text = GenerateText(generator, DICTIONARY_SIZE, 8);
+            search_server.AddDocument(id, text, DocumentStatus::BANNED, {id});
+            expected_server.AddDocument(id, text, DocumentStatus::BANNED, {id});
+        }
+        search_server.SetDocumentStatus(1, DocumentStatus::IRRELEVANT);
+        expected_server.SetDocumentStatus(1, DocumentStatus::IRRELEVANT);
+        CheckSameIndex(expected_server, *search_server.GetSnapshot(), generator, DICTIONARY_SIZE, "after held snapshots"s);
+    }
+
+    // Readers check every snapshot they take while a writer changes the index
+    for (const PostingPartitioning partitioning : {PostingPartitioning::NONE, PostingPartitioning::BY_STATUS}) {
+        ConcurrentSearchServer search_server("w3"s, PostingStorage::PLAIN, partitioning);
+        SearchServer expected_server("w3"s, PostingStorage::PLAIN, partitioning);
+        search_server.EnableResultCache(1 << 20);
+        std::atomic<bool> is_writing = true;
+        std::vector<std::thread> readers;
+        for (int reader = 0; reader < 4; ++reader) {
+            readers.emplace_back([&, reader] {
+                std::mt19937 reader_generator(reader);
+                while (is_writing.load()) {
+                    const auto snapshot = search_server.GetSnapshot();
+                    const std::set<int> document_ids(snapshot->begin(), snapshot->end());
+                    ASSERT_EQUAL(static_cast<size_t>(snapshot->GetDocumentCount()), document_ids.size());
+                    for (int i = 0; i < 5; ++i) {
+                        const std::string query = GenerateText(reader_generator, DICTIONARY_SIZE, 3, 0.2);
+                        for (const Document& document : snapshot->FindTopDocuments(query, GenerateStatus(reader_generator))) {
+                            ASSERT(document_ids.count(document.id) > 0);
+                        }
+                    }
+                }
+            });
+        }
+        for (int id = 0; id < 2000; ++id) {
+            const std::string text = GenerateText(generator, DICTIONARY_SIZE, 8);
+            const DocumentStatus status = GenerateStatus(generator);
+            search_server.AddDocument(id, text, status, {id % 10});
+            expected_server.AddDocument(id, text, status, {id % 10});
+            if (id % 7 == 0) {
+                search_server.RemoveDocument(id / 2);
+                expected_server.RemoveDocument(id / 2);
+            } else if (id % 7 == 1 && expected_server.begin() != expected_server.end()) {
+                const int changed_id = *expected_server.begin();
+                search_server.SetDocumentStatus(changed_id, status);
+                expected_server.SetDocumentStatus(changed_id, status);
+            }
+            if (id % 500 == 499) {
+                search_server.CompactIndex();
+                expected_server.CompactIndex();
+            }
+        }
+        is_writing = false;
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        CheckSameIndex(expected_server, *search_server.GetSnapshot(), generator, DICTIONARY_SIZE,
+                       "partitioning "s + std::to_string(static_cast<int>(partitioning)) + ", concurrent readers"s);
+    }
+}
+
+void TestProcessQueriesJoined() {
+    constexpr int DICTIONARY_SIZE = 50;
+    std::mt19937 generator;
+    SearchServer search_server("w3"s);
+    AddRandomDocuments(search_server, generator, 0, 20000, DICTIONARY_SIZE);
+    std::vector<std::string> queries;
+    for (int i = 0; i < 1000; ++i) {
+        queries.push_back(GenerateText(generator, DICTIONARY_SIZE, 3, 0.1));
+    }
+
+    std::vector<Document> expected;
+    for (const std::vector<Document>& documents : ProcessQueries(search_server, queries)) {
+        expected.insert(expected.end(), documents.begin(), documents.end());
+    }
+    for (const size_t window_size : {size_t{1}, size_t{7}, size_t{4096}}) {
+        std::vector<Document> documents;
+        ProcessQueriesJoined(search_server, queries, [&documents](const Document& document) {
+            documents.push_back(document);
+        }, window_size);
+        ASSERT_EQUAL_HINT(documents.size(), expected.size(), "window "s + std::to_string(window_size));
+        // Documents of equal relevance may come in another order
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT(std::abs(documents[i].relevance - expected[i].relevance) <= 1e-9);
+        }
+    }
+    const std::list<Document> joined = ProcessQueriesJoined(search_server, queries);
+    ASSERT_EQUAL(joined.size(), expected.size());
+
+    // Errors of the search and of the callback stop the producer and reach the caller
+    std::vector<std::string> invalid_queries = queries;
+    invalid_queries[queries.size() / 2] = "w1 --w2"s;
+    bool is_thrown = false;
+    try {
+        ProcessQueriesJoined(search_server, invalid_queries, [](const Document&) {}, 16);
+    } catch (const std::invalid_argument&) {
+        is_thrown = true;
+    }
+    ASSERT(is_thrown);
+    is_thrown = false;
+    size_t callback_count = 0;
+    try {
+        ProcessQueriesJoined(search_server, queries, [&callback_count](const Document&) {
+            if (++callback_count == 100) {
+                throw std::runtime_error("stop"s);
+            }
+        }, 16);
+    } catch (const std::runtime_error&) {
+        is_thrown = true;
+    }
+    ASSERT(is_thrown && callback_count == 100);
+
+    // Every query has thousands of candidates, while only two windows of tops may be held
+    for (int i = 0; i < 19; ++i) {
+        queries.insert(queries.end(), queries.begin(), queries.begin() + 1000);
+    }
+    ResetPeakMemory();
+    const size_t initial_memory = GetPeakMemory();
+    size_t document_count = 0;
+    ProcessQueriesJoined(search_server, queries, [&document_count](const Document&) {
+        ++document_count;
+    });
+    ASSERT(document_count > queries.size());
+    if (initial_memory > 0) {
+        ASSERT_HINT(GetPeakMemory() - initial_memory < 64 * 1024, "peak memory grew by "s
+                    + std::to_string(GetPeakMemory() - initial_memory) + " kB"s);
+    }
+}
+
+void TestQueryExecutor() {
+    constexpr int DICTIONARY_SIZE = 100;
+    std::mt19937 generator;
+    auto search_server = std::make_shared<SearchServer>("w3"s);
+    AddRandomDocuments(*search_server, generator, 0, 1000, DICTIONARY_SIZE);
+
+    // Results, invalid queries and expired deadlines on a free running executor
+    {
+        QueryExecutor executor(*search_server, 4, 64);
+        std::vector<std::string> queries;
+        std::vector<QueryExecutor::PendingQuery> pending_queries;
+        for (int i = 0; i < 50; ++i) {
+            queries.push_back(GenerateText(generator, DICTIONARY_SIZE, 3, 0.2));
+            pending_queries.push_back(*executor.Submit(queries.back(), DocumentStatus::BANNED));
+        }
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto expected = search_server->FindTopDocuments(queries[i], DocumentStatus::BANNED);
+            const auto documents = pending_queries[i].Get();
+            ASSERT_EQUAL(documents.size(), expected.size());
+            for (size_t j = 0; j < documents.size(); ++j) {
+                ASSERT_EQUAL(documents[j].id, expected[j].id);
+            }
+        }
+
+        auto invalid_query = *executor.Submit("w1 --w2"s);
+        bool is_thrown = false;
+        try {
+            invalid_query.Get();
+        } catch (const std::invalid_argument&) {
+            is_thrown = true;
+        }
+        ASSERT(is_thrown);
+
+        auto expired_query = *executor.Submit("w1"s, DocumentStatus::ACTUAL, QueryExecutor::Clock::now() - std::chrono::seconds(1));
+        is_thrown = false;
+        try {
+            expired_query.Get();
+        } catch (const QueryCancelledError&) {
+            is_thrown = true;
+        }
+        ASSERT(is_thrown);
+        const auto stats = executor.GetStats();
+        ASSERT_EQUAL(stats.completed, uint64_t{50});
+        ASSERT_EQUAL(stats.cancelled, uint64_t{1});
+        ASSERT_EQUAL(stats.rejected, uint64_t{0});
+    }
+
+    // The only worker is held in the search server source while queries pile up behind it
+    {
+        std::promise<void> entered;
+        std::promise<void> released;
+        std::shared_future<void> release = released.get_future().share();
+        bool is_first = true;
+        QueryExecutor executor([&]() {
+            if (is_first) {
+                is_first = false;
+                entered.set_value();
+                release.wait();
+            }
+            return std::shared_ptr<const SearchServer>(search_server);
+        }, 1, 2);
+        auto blocking_query = *executor.Submit("w1"s);
+        entered.get_future().wait();
+
+        auto cancelled_query = executor.Submit("w1"s);
+        auto waiting_query = executor.Submit("w2"s);
+        ASSERT(cancelled_query && waiting_query);
+        ASSERT(!executor.Submit("w3"s));
+        ASSERT_EQUAL(executor.GetStats().rejected, uint64_t{1});
+        ASSERT_EQUAL(executor.GetStats().queued, size_t{2});
+        cancelled_query->Cancel();
+        released.set_value();
+
+        ASSERT_EQUAL(blocking_query.Get().size(), search_server->FindTopDocuments("w1"s).size());
+        ASSERT_EQUAL(waiting_query->Get().size(), search_server->FindTopDocuments("w2"s).size());
+        bool is_thrown = false;
+        try {
+            cancelled_query->Get();
+        } catch (const QueryCancelledError&) {
+            is_thrown = true;
+        }
+        ASSERT(is_thrown);
+        // The slots are free again
+        ASSERT(executor.Submit("w3"s));
+    }
+}
+
+void TestRequestQueue() {
+    using namespace std::chrono_literals;
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "big dog"s, DocumentStatus::ACTUAL, {2});
+
+    // Requests leave the statistics with the window, whatever their number
+    {
+        RequestQueue request_queue(search_server, 10min);
+        ASSERT_EQUAL(request_queue.AddFindRequest("cat"s).size(), size_t{1});
+        ASSERT(request_queue.AddFindRequest("parrot"s).empty());
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1);
+        const auto now = RequestQueue::Clock::now();
+        request_queue.Record("parrot"s, 0, 1ms, now - 20min);
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1);
+        ASSERT_EQUAL(request_queue.GetStats(10min, 10, now).request_count, uint64_t{2});
+        ASSERT_EQUAL(request_queue.GetStats(10min, 10, now + 11min).request_count, uint64_t{0});
+    }
+
+    // A late record of a minute whose bucket has moved on is dropped
+    {
+        RequestQueue request_queue(search_server, 10min);
+        const auto now = RequestQueue::Clock::now();
+        request_queue.Record("cat"s, 1, 1ms, now);
+        request_queue.Record("dog"s, 1, 1ms, now - 10min);
+        request_queue.Record("dog"s, 0, 1ms, now - 20min);
+        const auto stats = request_queue.GetStats(10min, 10, now);
+        ASSERT_EQUAL(stats.request_count, uint64_t{1});
+        ASSERT_EQUAL(stats.no_result_count, uint64_t{0});
+    }
+
+    // Percentiles are reported as the upper bound of their power of two bucket
+    {
+        RequestQueue request_queue(search_server, 10min);
+        const auto now = RequestQueue::Clock::now();
+        for (int i = 0; i < 90; ++i) {
+            request_queue.Record("cat"s, 1, 3us, now);
+        }
+        for (int i = 0; i < 9; ++i) {
+            request_queue.Record("cat"s, 1, 100us, now);
+        }
+        request_queue.Record("cat"s, 0, 5000us, now);
+        const auto stats = request_queue.GetStats(10min, 10, now);
+        ASSERT_EQUAL(stats.latency_p50.count(), 4);
+        ASSERT_EQUAL(stats.latency_p90.count(), 128);
+        ASSERT_EQUAL(stats.latency_p99.count(), 8192);
+        ASSERT(std::abs(stats.no_result_rate - 0.01) < 1e-9);
+    }
+
+    // Space-Saving: a newcomer to a full sketch replaces the least counted query and inherits its count
+    {
+        RequestQueue request_queue(search_server, 10min);
+        const auto now = RequestQueue::Clock::now();
+        for (int i = 0; i < 64; ++i) {
+            for (int j = 0; j <= i; ++j) {
+                request_queue.Record("q"s + std::to_string(i), 1, 1ms, now);
+            }
+        }
+        for (int i = 0; i < 10; ++i) {
+            request_queue.Record("hot"s, 1, 1ms, now);
+        }
+        const auto stats = request_queue.GetStats(10min, 100, now);
+        ASSERT_EQUAL(stats.top_queries.size(), size_t{64});
+        ASSERT_EQUAL(stats.top_queries.back().first, "q1"s);
+        ASSERT_EQUAL(stats.top_queries.back().second, uint64_t{2});
+        const auto hot = std::find_if(stats.top_queries.begin(), stats.top_queries.end(), [](const auto& query) {
+            return query.first == "hot"s;
+        });
+        ASSERT(hot != stats.top_queries.end() && hot->second == 11);
+        ASSERT(std::none_of(stats.top_queries.begin(), stats.top_queries.end(), [](const auto& query) {
+            return query.first == "q0"s;
+        }));
+        ASSERT_EQUAL(request_queue.GetStats(10min, 1, now).top_queries.front().first, "q63"s);
+    }
+}
+
+void TestSearchServer() {
+    RUN_TEST(TestSplitIntoWords);
+    RUN_TEST(TestPostingBlockDecoders);
+    RUN_TEST(TestCompressedPostingList);
+    RUN_TEST(TestPrunedTopDocuments);
+    RUN_TEST(TestResultCache);
+    RUN_TEST(TestSnapshot);
+    RUN_TEST(TestConcurrentSearchServer);
+    RUN_TEST(TestProcessQueriesJoined);
+    RUN_TEST(TestQueryExecutor);
+    RUN_TEST(TestRequestQueue);
+}
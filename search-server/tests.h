@@ -0,0 +1,35 @@
+#pragma once
+
+// Checks of the index internals against reference results on random data. main runs them
+// before anything else; a failed check prints what went wrong and aborts.
+void TestSearchServer();
+
+// Compares SplitIntoWords and HasControlCharacters with a byte-by-byte reference on random texts
+// of spaces, control and high-bit bytes that cross the 32-byte blocks of the SIMD scan
+void TestSplitIntoWords();
+// Decodes random blocks with the SSE2 and the scalar block decoders and compares them
+// with each other and with the encoded ids
+void TestPostingBlockDecoders();
+// Builds compressed posting lists and reads them back with ForEach, ForEachInRange and Cursor
+void TestCompressedPostingList();
+// Compares the MaxScore path of FindTopDocuments(query, status) with the exhaustive scoring of
+// a status predicate, on random corpora in every posting storage and partitioning, with
+// removals, status changes and compaction
+void TestPrunedTopDocuments();
+// Hits and misses of the result cache, invalidation by every change of the documents, LRU eviction
+// within the memory budget, and the budget split between the copies of a concurrent server
+void TestResultCache();
+// Saves random indexes, loads them back and changes both copies alike; both must keep giving the
+// same results. Truncated or otherwise corrupt snapshots must be rejected
+void TestSnapshot();
+// Holds snapshots of a concurrent server across writes and reads it from several threads while
+// it is written to; it must end up like a plain server given the same changes
+void TestConcurrentSearchServer();
+// The streaming ProcessQueriesJoined must give the results of ProcessQueries in order for any window
+// size, pass on errors, and hold only a bounded amount of memory for many queries
+void TestProcessQueriesJoined();
+// Results and errors of queries run by a QueryExecutor: invalid queries, expired deadlines,
+// Cancel, and rejection once max_queued_count queries wait
+void TestQueryExecutor();
+// Window expiry, dropping of late records, latency percentiles and the top query sketch of RequestQueue
+void TestRequestQueue();
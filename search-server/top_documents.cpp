@@ -0,0 +1,47 @@
+#include "top_documents.h"
+
+#include <algorithm>
+
+TopDocuments::TopDocuments(size_t capacity)
+        : capacity_(capacity) {
+}
+
+void TopDocuments::Reset(size_t capacity) {
+    capacity_ = capacity;
+    heap_.clear();
+}
+
+bool TopDocuments::IsFull() const {
+    return heap_.size() >= capacity_;
+}
+
+const Document& TopDocuments::GetWorst() const {
+    return heap_.front();
+}
+
+void TopDocuments::Add(const Document& document) {
+    if (capacity_ == 0) {
+        return;
+    }
+    if (!IsFull()) {
+        heap_.push_back(document);
+        std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    } else if (IsMoreRelevant(document, heap_.front())) {
+        std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        heap_.back() = document;
+        std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+}
+
+std::vector<Document> TopDocuments::Extract() {
+    std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    std::vector<Document> documents;
+    documents.swap(heap_);
+    return documents;
+}
+
+void TopDocuments::Extract(std::vector<Document>& documents) {
+    std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    documents.swap(heap_);
+    heap_.clear();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "document.h"
+
+// Bounded collection of the best documents seen so far, in the order of IsMoreRelevant.
+// The least relevant kept document sits on top of a heap, so every Add costs O(log capacity).
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t capacity);
+
+    // Empties the collection for another query, keeping its storage
+    void Reset(size_t capacity);
+
+    bool IsFull() const;
+    // The document a newcomer has to beat once the collection is full
+    const Document& GetWorst() const;
+
+    void Add(const Document& document);
+
+    // Returns the kept documents, best first, and leaves the collection empty
+    std::vector<Document> Extract();
+    // Same, into documents; its storage is kept for the next query
+    void Extract(std::vector<Document>& documents);
+
+private:
+    size_t capacity_;
+    std::vector<Document> heap_;
+};